@@ -0,0 +1,1192 @@
+#include "Benchmark.h"
+
+//External includes
+#include "SDL.h"
+
+//Standard includes
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+//Project includes
+#include "Coverage.h"
+#include "CpuFeatures.h"
+#include "Material.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "Utils.h"
+
+namespace dae
+{
+	//Set associative cache with LRU replacement, only counts hits and misses
+	class CacheSimulator final
+	{
+	public:
+		static constexpr uint32_t LineSize{ 64 };
+
+		CacheSimulator(uint32_t sizeInBytes, uint32_t nrWays) :
+			m_NrWays{ nrWays },
+			m_NrSets{ sizeInBytes / (LineSize * nrWays) },
+			m_Tags(static_cast<size_t>(m_NrSets) * nrWays, UINT64_MAX),
+			m_LastUsed(static_cast<size_t>(m_NrSets) * nrWays)
+		{
+		}
+
+		//Returns true on a hit, on a miss the least recently used line of the set is replaced
+		bool Access(uint64_t address)
+		{
+			const uint64_t line{ address / LineSize };
+			const size_t first{ static_cast<size_t>(line % m_NrSets) * m_NrWays };
+			++m_Clock;
+
+			size_t oldest{ first };
+			for (size_t way{ first }; way < first + m_NrWays; ++way)
+			{
+				if (m_Tags[way] == line)
+				{
+					m_LastUsed[way] = m_Clock;
+					return true;
+				}
+
+				if (m_LastUsed[way] < m_LastUsed[oldest])
+					oldest = way;
+			}
+
+			m_Tags[oldest] = line;
+			m_LastUsed[oldest] = m_Clock;
+			return false;
+		}
+
+	private:
+		uint32_t m_NrWays;
+		uint32_t m_NrSets;
+		std::vector<uint64_t> m_Tags;
+		std::vector<uint64_t> m_LastUsed;
+		uint64_t m_Clock{};
+	};
+
+	//Milliseconds of the fastest of nrRuns calls
+	static float TimeFastest(int nrRuns, const std::function<void()>& run)
+	{
+		float fastest{ INFINITY };
+		for (int runIdx{}; runIdx < nrRuns; ++runIdx)
+		{
+			const auto start{ std::chrono::high_resolution_clock::now() };
+			run();
+			const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+			fastest = std::min(fastest, elapsed.count());
+		}
+		return fastest;
+	}
+
+	bool Benchmark::Run(const std::string& name)
+	{
+		if (name == "traversal")
+		{
+			RunTraversal();
+			return true;
+		}
+
+		if (name == "texturelayout")
+		{
+			RunTextureLayout();
+			return true;
+		}
+
+		if (name == "texturecompression")
+		{
+			RunTextureCompression();
+			return true;
+		}
+
+		if (name == "objload")
+		{
+			RunObjLoad();
+			return true;
+		}
+
+		if (name == "vertexwelding")
+		{
+			RunVertexWelding();
+			return true;
+		}
+
+		if (name == "meshcache")
+		{
+			RunMeshCache();
+			return true;
+		}
+
+		if (name == "vertexstage")
+		{
+			RunVertexStage();
+			return true;
+		}
+
+		if (name == "lazyvertices")
+		{
+			RunLazyVertices();
+			return true;
+		}
+
+		if (name == "frustumculling")
+		{
+			RunFrustumCulling();
+			return true;
+		}
+
+		if (name == "meshlets")
+		{
+			RunMeshlets();
+			return true;
+		}
+
+		if (name == "scenebvh")
+		{
+			RunSceneBVH();
+			return true;
+		}
+
+		return false;
+	}
+
+	void Benchmark::RunTraversal()
+	{
+		const Int2 resolutions[]{ { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+		const std::pair<Coverage::TraversalOrder, const char*> orders[]
+		{
+			{ Coverage::TraversalOrder::ColumnMajor, "ColumnMajor" },
+			{ Coverage::TraversalOrder::RowMajor, "RowMajor" },
+			{ Coverage::TraversalOrder::Blocked, "Blocked" }
+		};
+		constexpr int nrFrames{ 20 };
+
+		std::cout << "Traversal benchmark, " << Coverage::GetBlockFunctionName(Coverage::SelectBlockFunction()) << " coverage, "
+			<< nrFrames << " frames per run, simulated 32KB/8-way L1 and 1MB/16-way L2\n";
+
+		for (const Int2& resolution : resolutions)
+		{
+			WithRenderer(resolution.x, resolution.y, [&](Renderer& renderer)
+				{
+					for (const auto& [order, name] : orders)
+					{
+						renderer.m_TraversalOrder = order;
+						renderer.Render_Week2();
+
+						const auto start{ std::chrono::high_resolution_clock::now() };
+						for (int frame{}; frame < nrFrames; ++frame)
+						{
+							renderer.Render_Week2();
+						}
+						const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+
+						const CacheMisses misses{ SimulateTraversal(renderer) };
+
+						char line[256]{};
+						snprintf(line, sizeof(line), "%4dx%-4d  %-11s  %8.2f ms  L1 misses %10llu (%5.2f%%)  L2 misses %10llu (%5.2f%%)",
+							resolution.x, resolution.y, name, elapsed.count() / nrFrames,
+							static_cast<unsigned long long>(misses.l1), 100.f * misses.l1 / std::max<uint64_t>(misses.accesses, 1),
+							static_cast<unsigned long long>(misses.l2), 100.f * misses.l2 / std::max<uint64_t>(misses.accesses, 1));
+						std::cout << line << '\n';
+					}
+				});
+		}
+	}
+
+	void Benchmark::WithRenderer(int width, int height, const std::function<void(Renderer&)>& run)
+	{
+		SDL_Window* pWindow{ SDL_CreateWindow("Benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_HIDDEN) };
+		if (!pWindow)
+			return;
+
+		{
+			Renderer renderer{ pWindow };
+			Timer timer{};
+
+			//Every run has to render the exact same frames
+			renderer.ToggleRotation();
+			renderer.Update(&timer);
+
+			run(renderer);
+		}
+
+		SDL_DestroyWindow(pWindow);
+	}
+
+	void Benchmark::SetView(Renderer& renderer, const Vector3& origin, float pitch, float yaw)
+	{
+		renderer.m_Camera.origin = origin;
+		renderer.m_Camera.totalPitch = pitch;
+		renderer.m_Camera.totalYaw = yaw;
+		renderer.m_Camera.CalculateViewMatrix();
+	}
+
+	Benchmark::CacheMisses Benchmark::SimulateTraversal(const Renderer& renderer)
+	{
+		constexpr uint64_t lineSize{ 64 };
+		const int width{ renderer.m_Width };
+		const int height{ renderer.m_Height };
+
+		//Depth and color buffer as two page aligned allocations
+		const uint64_t depthBase{};
+		const uint64_t colorBase{ (static_cast<uint64_t>(width) * height * sizeof(float) + 4095) / 4096 * 4096 };
+
+		CacheSimulator l1{ 32 * 1024, 8 };
+		CacheSimulator l2{ 1024 * 1024, 16 };
+		CacheMisses misses{};
+		const auto access{ [&](uint64_t address)
+			{
+				++misses.accesses;
+				if (l1.Access(address))
+					return;
+
+				++misses.l1;
+				if (!l2.Access(address))
+					++misses.l2;
+			} };
+
+		//Coverage is replayed on a scratch depth buffer so the color writes match the real frame
+		std::vector<float> depthBuffer(static_cast<size_t>(width) * height);
+
+		for (int tileIdx{}; tileIdx < renderer.m_NrTilesX * renderer.m_NrTilesY; ++tileIdx)
+		{
+			const Int2 tileMin{ (tileIdx % renderer.m_NrTilesX) * Renderer::TileSize, (tileIdx / renderer.m_NrTilesX) * Renderer::TileSize };
+			const Int2 tileMax{ std::min(tileMin.x + Renderer::TileSize, width) - 1, std::min(tileMin.y + Renderer::TileSize, height) - 1 };
+
+			for (int py{ tileMin.y }; py <= tileMax.y; ++py)
+			{
+				for (int px{ tileMin.x }; px <= tileMax.x; ++px)
+				{
+					const uint64_t offset{ (static_cast<uint64_t>(py) * width + px) * sizeof(float) };
+					depthBuffer[py * width + px] = INFINITY;
+					if (offset % lineSize == 0 || px == tileMin.x)
+					{
+						access(depthBase + offset);
+						access(colorBase + offset);
+					}
+				}
+			}
+
+			for (const Renderer::BinChunk& chunk : renderer.m_BinChunks)
+			{
+				for (const uint32_t triIdx : chunk.tileBins[tileIdx])
+				{
+					const TriangleSetup& triangle{ chunk.triangles[triIdx] };
+					Coverage::TraverseBlocks(renderer.m_TraversalOrder, triangle, tileMin, tileMax, [&](int bx, int by)
+						{
+							//One depth load per block row, a 4 wide row never crosses a cache line
+							for (int ly{}; ly < Coverage::BlockHeight && by + ly <= tileMax.y; ++ly)
+							{
+								access(depthBase + (static_cast<uint64_t>(by + ly) * width + bx) * sizeof(float));
+							}
+
+							uint32_t mask{ Coverage::TestBlock_Scalar(triangle, bx, by, depthBuffer.data(), width, Coverage::GetValidMask(bx, by, tileMax)) };
+							while (mask != 0)
+							{
+								const int lane{ std::countr_zero(mask) };
+								mask &= mask - 1;
+
+								const int px{ bx + lane % Coverage::BlockWidth };
+								const int py{ by + lane / Coverage::BlockWidth };
+								access(colorBase + (static_cast<uint64_t>(py) * width + px) * sizeof(uint32_t));
+							}
+						});
+				}
+			}
+		}
+
+		return misses;
+	}
+
+	void Benchmark::RunTextureLayout()
+	{
+		const Int2 resolutions[]{ { 640, 480 }, { 1280, 720 } };
+		const std::pair<TextureLayout, const char*> layouts[]
+		{
+			{ TextureLayout::Linear, "Linear" },
+			{ TextureLayout::Tiled4x4, "Tiled4x4" },
+			{ TextureLayout::Tiled8x8, "Tiled8x8" },
+			{ TextureLayout::Morton, "Morton" }
+		};
+		//A full turn, so the uv gradients run in every direction on screen
+		constexpr int nrFrames{ 12 };
+
+		std::cout << "Texture layout benchmark, trilinear, " << nrFrames << " frames per turn, simulated 32KB/8-way L1 and 1MB/16-way L2 on the texel reads\n";
+
+		for (const Int2& resolution : resolutions)
+		{
+			WithRenderer(resolution.x, resolution.y, [&](Renderer& renderer)
+				{
+					//Rotation is set per frame below, every layout sees the exact same frames
+					const Matrix startWorldMatrix{ renderer.m_MeshesWorld[1].worldMatrix };
+
+					for (const auto& [layout, name] : layouts)
+					{
+						renderer.LoadVehicleMaterial(layout);
+
+						float totalTime{};
+						CacheMisses misses{};
+						for (int frame{}; frame < nrFrames; ++frame)
+						{
+							renderer.m_MeshesWorld[1].worldMatrix = Matrix::CreateRotationY(360.f / nrFrames * frame * TO_RADIANS) * startWorldMatrix;
+							renderer.OnMeshMoved(1);
+
+							const auto start{ std::chrono::high_resolution_clock::now() };
+							renderer.Render_Week2();
+							const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+							totalTime += elapsed.count();
+
+							const CacheMisses frameMisses{ SimulateTextureFetches(renderer) };
+							misses.accesses += frameMisses.accesses;
+							misses.l1 += frameMisses.l1;
+							misses.l2 += frameMisses.l2;
+						}
+
+						char line[256]{};
+						snprintf(line, sizeof(line), "%4dx%-4d  %-8s  %8.2f ms  L1 misses %10llu (%5.2f%%)  L2 misses %10llu (%5.2f%%)",
+							resolution.x, resolution.y, name, totalTime / nrFrames,
+							static_cast<unsigned long long>(misses.l1), 100.f * misses.l1 / std::max<uint64_t>(misses.accesses, 1),
+							static_cast<unsigned long long>(misses.l2), 100.f * misses.l2 / std::max<uint64_t>(misses.accesses, 1));
+						std::cout << line << '\n';
+					}
+
+					renderer.LoadVehicleMaterial(TextureLayout::Linear);
+				});
+		}
+	}
+
+	void Benchmark::RunTextureCompression()
+	{
+		const Int2 resolutions[]{ { 640, 480 }, { 1280, 720 } };
+		constexpr int nrFrames{ 12 };
+
+		std::cout << "Texture compression benchmark, trilinear, " << nrFrames << " frames per turn, PSNR of the color buffer against the uncompressed material\n";
+
+		for (const Int2& resolution : resolutions)
+		{
+			WithRenderer(resolution.x, resolution.y, [&](Renderer& renderer)
+				{
+					const Matrix startWorldMatrix{ renderer.m_MeshesWorld[1].worldMatrix };
+					const size_t nrPixels{ static_cast<size_t>(renderer.m_Width) * renderer.m_Height };
+
+					//Frames of the uncompressed run, the compressed run is compared against them
+					std::vector<uint32_t> referenceFrames(nrPixels * nrFrames);
+					size_t uncompressedSize{};
+
+					for (const bool isBlockCompressed : { false, true })
+					{
+						const auto loadStart{ std::chrono::high_resolution_clock::now() };
+						renderer.LoadVehicleMaterial(TextureLayout::Linear, isBlockCompressed);
+						const std::chrono::duration<float, std::milli> loadTime{ std::chrono::high_resolution_clock::now() - loadStart };
+
+						const size_t size{ renderer.m_pVehicleMaterial->GetMemorySize() };
+						if (!isBlockCompressed)
+							uncompressedSize = size;
+
+						float totalTime{};
+						double squaredError{};
+						for (int frame{}; frame < nrFrames; ++frame)
+						{
+							renderer.m_MeshesWorld[1].worldMatrix = Matrix::CreateRotationY(360.f / nrFrames * frame * TO_RADIANS) * startWorldMatrix;
+							renderer.OnMeshMoved(1);
+
+							const auto start{ std::chrono::high_resolution_clock::now() };
+							renderer.Render_Week2();
+							const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+							totalTime += elapsed.count();
+
+							uint32_t* pReference{ referenceFrames.data() + nrPixels * frame };
+							for (size_t idx{}; idx < nrPixels; ++idx)
+							{
+								const uint32_t pixel{ renderer.m_pBackBufferPixels[idx] };
+								if (!isBlockCompressed)
+								{
+									pReference[idx] = pixel;
+									continue;
+								}
+
+								for (int shift{}; shift < 24; shift += 8)
+								{
+									const int difference{ static_cast<int>((pixel >> shift) & 0xFF) - static_cast<int>((pReference[idx] >> shift) & 0xFF) };
+									squaredError += difference * difference;
+								}
+							}
+						}
+
+						const double meanSquaredError{ squaredError / (3.0 * nrPixels * nrFrames) };
+						char psnr[32]{ "-" };
+						if (isBlockCompressed)
+							snprintf(psnr, sizeof(psnr), "%.2f dB", meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY);
+
+						char line[256]{};
+						snprintf(line, sizeof(line), "%4dx%-4d  %-12s  %7.2f MB (%4.2fx smaller)  load %8.2f ms  %8.2f ms  PSNR %s",
+							resolution.x, resolution.y, isBlockCompressed ? "BC3/BC5/BC1" : "RGBA8", size / (1024.f * 1024.f),
+							static_cast<float>(uncompressedSize) / size, loadTime.count(), totalTime / nrFrames, psnr);
+						std::cout << line << '\n';
+					}
+
+					renderer.LoadVehicleMaterial(TextureLayout::Linear);
+				});
+		}
+	}
+
+	void Benchmark::RunObjLoad()
+	{
+		const char* paths[]{ "Resources/tuktuk.obj", "Resources/vehicle.obj" };
+		constexpr int nrRuns{ 10 };
+		ThreadPool threadPool{};
+
+		std::cout << "OBJ load benchmark, fastest of " << nrRuns << " runs, " << threadPool.GetThreadCount() << " threads in the pool\n";
+
+		for (const char* path : paths)
+		{
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			const float referenceTime{ TimeFastest(nrRuns, [&] { Utils::ParseOBJ(path, vertices, indices); }) };
+			const std::vector<Vertex> referenceVertices{ vertices };
+			const std::vector<uint32_t> referenceIndices{ indices };
+
+			//Vertex is all floats, so equal bytes means equal output
+			const auto isIdentical{ [&]
+				{
+					return vertices.size() == referenceVertices.size() && indices == referenceIndices
+						&& std::memcmp(vertices.data(), referenceVertices.data(), vertices.size() * sizeof(Vertex)) == 0;
+				} };
+
+			const float singleThreadTime{ TimeFastest(nrRuns, [&] { ObjParser::Parse(path, vertices, indices, true, false); }) };
+			const bool isSingleThreadIdentical{ isIdentical() };
+			const float threadPoolTime{ TimeFastest(nrRuns, [&] { ObjParser::Parse(path, vertices, indices, true, false, &threadPool); }) };
+			const bool isThreadPoolIdentical{ isIdentical() };
+
+			char line[256]{};
+			snprintf(line, sizeof(line), "%-22s  %7zu triangles  ParseOBJ %8.2f ms  ObjParser %8.2f ms (%5.2fx)  on the pool %8.2f ms (%5.2fx)  output %s",
+				path, referenceIndices.size() / 3, referenceTime, singleThreadTime, referenceTime / singleThreadTime, threadPoolTime, referenceTime / threadPoolTime,
+				isSingleThreadIdentical && isThreadPoolIdentical ? "identical" : "DIFFERENT");
+			std::cout << line << '\n';
+		}
+	}
+
+	void Benchmark::RunVertexWelding()
+	{
+		const char* paths[]{ "Resources/tuktuk.obj", "Resources/vehicle.obj" };
+		constexpr int nrRuns{ 50 };
+
+		std::cout << "Vertex welding benchmark, fastest VertexTransformationFunction of " << nrRuns << " runs\n";
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				for (const char* path : paths)
+				{
+					float times[2]{};
+					size_t nrVertices[2]{};
+					size_t nrTriangles{};
+					for (const bool weldVertices : { false, true })
+					{
+						std::vector<Vertex> vertices{};
+						std::vector<uint32_t> indices{};
+						ObjParser::Parse(path, vertices, indices, true, weldVertices);
+
+						Mesh mesh{};
+						mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+						mesh.vertices = MeshArray<Vertex>{ std::move(vertices) };
+						mesh.indices = MeshArray<uint32_t>{ std::move(indices) };
+						mesh.vertexStreams = MeshArray<float>{ MeshCache::CreateVertexStreams(mesh.vertices.data(), mesh.vertices.size()) };
+						mesh.vertices_out.resize(mesh.vertices.size());
+						mesh.clipCodes_out.resize(mesh.vertices.size());
+
+						times[weldVertices] = TimeFastest(nrRuns, [&] { renderer.VertexTransformationFunction(mesh); });
+						nrVertices[weldVertices] = mesh.vertices.size();
+						nrTriangles = mesh.GetTriangleCount();
+					}
+
+					char line[256]{};
+					snprintf(line, sizeof(line), "%-22s  %7zu triangles  vertices %7zu -> %7zu (%4.2fx fewer)  VertexTransformationFunction %6.3f ms -> %6.3f ms (%6.3f ms saved)",
+						path, nrTriangles, nrVertices[0], nrVertices[1], static_cast<float>(nrVertices[0]) / nrVertices[1], times[0], times[1], times[0] - times[1]);
+					std::cout << line << '\n';
+				}
+			});
+	}
+
+	void Benchmark::RunMeshCache()
+	{
+		const char* paths[]{ "Resources/tuktuk.obj", "Resources/vehicle.obj" };
+		constexpr int nrRuns{ 10 };
+		ThreadPool threadPool{};
+
+		std::cout << "Mesh cache benchmark, fastest of " << nrRuns << " runs, " << threadPool.GetThreadCount() << " threads in the pool\n";
+
+		for (const char* path : paths)
+		{
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			const float parseTime{ TimeFastest(nrRuns, [&] { ObjParser::Parse(path, vertices, indices, true, true, &threadPool); }) };
+			const float buildTime{ TimeFastest(nrRuns, [&] { MeshCache::Build(path, true, true, &threadPool); }) };
+
+			//Mapping alone doesn't read anything, so also time touching every page like the first frame does
+			Mesh mesh{};
+			const float loadTime{ TimeFastest(nrRuns, [&] { MeshCache::Load(path, mesh, true, true, &threadPool); }) };
+			volatile uint64_t checksum{};
+			const float firstTouchTime{ TimeFastest(nrRuns, [&]
+				{
+					MeshCache::Load(path, mesh, true, true, &threadPool);
+					uint64_t sum{};
+					for (const Vertex& vertex : mesh.vertices)
+					{
+						sum += std::bit_cast<uint32_t>(vertex.position.x);
+					}
+					for (const uint32_t index : mesh.indices)
+					{
+						sum += index;
+					}
+					checksum = sum;
+				}) };
+
+			//The cache file holds the reordered mesh
+			const float acmrSource{ MeshOptimizer::GetACMR(indices.data(), indices.size(), vertices.size()) };
+			MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+			std::vector<Meshlet> meshlets{};
+			std::vector<uint32_t> meshletVertices{};
+			MeshOptimizer::BuildMeshlets(vertices, indices, meshlets, meshletVertices);
+			const float acmrOptimized{ MeshOptimizer::GetACMR(indices.data(), indices.size(), vertices.size()) };
+
+			//Vertex and Meshlet are all floats and integers, so equal bytes means equal output
+			const bool isIdentical{ mesh.pMappedFile && mesh.vertices.size() == vertices.size() && mesh.indices.size() == indices.size()
+				&& mesh.meshlets.size() == meshlets.size() && mesh.meshletVertices.size() == meshletVertices.size()
+				&& std::memcmp(mesh.vertices.data(), vertices.data(), vertices.size() * sizeof(Vertex)) == 0
+				&& std::memcmp(mesh.indices.data(), indices.data(), indices.size() * sizeof(uint32_t)) == 0
+				&& std::memcmp(mesh.meshlets.data(), meshlets.data(), meshlets.size() * sizeof(Meshlet)) == 0
+				&& std::memcmp(mesh.meshletVertices.data(), meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t)) == 0 };
+
+			char line[384]{};
+			snprintf(line, sizeof(line), "%-22s  %7zu vertices  ACMR %4.2f -> %4.2f  parse %8.2f ms  parse, optimize and write cache %8.2f ms  cached load %6.3f ms  cached load and first touch %6.3f ms (%6.1fx)  output %s",
+				path, vertices.size(), acmrSource, acmrOptimized, parseTime, buildTime, loadTime, firstTouchTime, parseTime / firstTouchTime, isIdentical ? "identical" : "DIFFERENT");
+			std::cout << line << '\n';
+		}
+	}
+
+	void Benchmark::RunVertexStage()
+	{
+		constexpr size_t nrVertices{ 2'000'000 };
+		constexpr int nrRuns{ 10 };
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				const Mesh& vehicle{ renderer.m_MeshesWorld[1] };
+
+				//The vehicle over and over, each copy a bit further away so not every vertex is the same
+				std::vector<Vertex> vertices(nrVertices);
+				for (size_t i{}; i < nrVertices; ++i)
+				{
+					vertices[i] = vehicle.vertices[i % vehicle.vertices.size()];
+					vertices[i].position.z += static_cast<float>(i / vehicle.vertices.size()) * 0.01f;
+				}
+
+				Mesh soaMesh{};
+				soaMesh.worldMatrix = vehicle.worldMatrix;
+				soaMesh.vertexStreams = MeshArray<float>{ MeshCache::CreateVertexStreams(vertices.data(), vertices.size()) };
+				soaMesh.vertices = MeshArray<Vertex>{ std::move(vertices) };
+				soaMesh.vertices_out.resize(nrVertices);
+				soaMesh.clipCodes_out.resize(nrVertices);
+
+				//Without vertex streams the scalar loop does everything
+				Mesh aosMesh{ soaMesh };
+				aosMesh.vertexStreams = MeshArray<float>{};
+
+				ThreadPool* pThreadPool{ renderer.m_pThreadPool };
+				ThreadPool singleThread{ 1 };
+
+				std::cout << "Vertex stage benchmark, " << nrVertices << " vertices, fastest of " << nrRuns << " runs, " << pThreadPool->GetThreadCount() << " threads in the pool"
+					<< (CpuFeatures::HasAVX2() ? "" : ", no AVX2 on this CPU") << '\n';
+
+				const auto time{ [&](Mesh& mesh, ThreadPool* pPool)
+					{
+						renderer.m_pThreadPool = pPool;
+						const float fastest{ TimeFastest(nrRuns, [&] { renderer.VertexTransformationFunction(mesh); }) };
+						renderer.m_pThreadPool = pThreadPool;
+						return fastest;
+					} };
+
+				const float times[]{ time(aosMesh, &singleThread), time(aosMesh, pThreadPool), time(soaMesh, &singleThread), time(soaMesh, pThreadPool) };
+
+				//Vertex_Out is all floats, so equal bytes means equal output
+				const bool isIdentical{ std::memcmp(aosMesh.vertices_out.data(), soaMesh.vertices_out.data(), nrVertices * sizeof(Vertex_Out)) == 0
+					&& aosMesh.clipCodes_out == soaMesh.clipCodes_out };
+
+				const char* names[]{ "scalar, 1 thread", "scalar, pool", "SoA AVX2, 1 thread", "SoA AVX2, pool" };
+				for (int i{}; i < 4; ++i)
+				{
+					char line[160]{};
+					snprintf(line, sizeof(line), "%-20s %8.2f ms  %7.1f M vertices/s  %5.2fx", names[i], times[i], nrVertices / (times[i] * 1000.f), times[0] / times[i]);
+					std::cout << line << '\n';
+				}
+				std::cout << "Output " << (isIdentical ? "identical" : "DIFFERENT") << '\n';
+			});
+	}
+
+	void Benchmark::RunLazyVertices()
+	{
+		struct View
+		{
+			const char* name;
+			Vector3 origin;
+			float yaw;
+		};
+		//The vehicle spans about 38 x 16 x 32 around the origin
+		const View views[]{
+			{ "outside", Vector3{ 0.f, 0.f, -30.f }, 0.f },
+			{ "near", Vector3{ 0.f, 2.f, -18.f }, 0.f },
+			{ "inside", Vector3{ 0.f, 2.f, 0.f }, 0.f },
+			{ "inside, backwards", Vector3{ 0.f, 2.f, 0.f }, PI } };
+		constexpr int nrFrames{ 20 };
+
+		std::cout << "Lazy vertices benchmark, vehicle at 640x480, " << nrFrames << " frames per view\n";
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				const Mesh& mesh{ renderer.m_MeshesWorld[1] };
+				const size_t nrPixels{ static_cast<size_t>(renderer.m_Width) * renderer.m_Height };
+
+				for (const View& view : views)
+				{
+					SetView(renderer, view.origin, 0.f, view.yaw);
+
+					float times[2]{};
+					RenderStats stats[2]{};
+					std::vector<uint32_t> frames[2]{};
+					for (const bool useLazyVertices : { false, true })
+					{
+						renderer.m_UseLazyVertices = useLazyVertices;
+						renderer.Render_Week2();
+
+						const auto start{ std::chrono::high_resolution_clock::now() };
+						for (int frame{}; frame < nrFrames; ++frame)
+						{
+							renderer.Render_Week2();
+						}
+						const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+
+						times[useLazyVertices] = elapsed.count() / nrFrames;
+						stats[useLazyVertices] = renderer.GetStats();
+						frames[useLazyVertices].assign(renderer.m_pBackBufferPixels, renderer.m_pBackBufferPixels + nrPixels);
+					}
+
+					const size_t nrNeeded{ CountLazyVertices(renderer, mesh) };
+					const size_t nrVertices{ mesh.vertices.size() };
+
+					char line[320]{};
+					snprintf(line, sizeof(line), "%-18s  triangles culled %5.1f%%  vertices needed %6zu of %6zu (%5.1f%% skipped)  transformed lazily %6u (%4.2f per needed)  frame %6.2f ms -> %6.2f ms  image %s",
+						view.name, 100.f * (stats[1].nrFrustumCulled + stats[1].nrFaceCulled) / std::max(stats[1].nrTriangles, 1u),
+						nrNeeded, nrVertices, 100.f * (nrVertices - nrNeeded) / nrVertices,
+						stats[1].nrVerticesTransformed, static_cast<float>(stats[1].nrVerticesTransformed) / std::max<size_t>(nrNeeded, 1),
+						times[0], times[1], frames[0] == frames[1] ? "identical" : "DIFFERENT");
+					std::cout << line << '\n';
+				}
+			});
+	}
+
+	void Benchmark::RunFrustumCulling()
+	{
+		constexpr int nrViews{ 2000 };
+
+		std::cout << "Frustum culling benchmark, vehicle from " << nrViews << " random views around it\n";
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				Mesh& mesh{ renderer.m_MeshesWorld[1] };
+
+				//Same views every run
+				std::mt19937 random{ 1 };
+				std::uniform_real_distribution<float> position{ -60.f, 60.f };
+				std::uniform_real_distribution<float> angle{ -PI, PI };
+
+				int nrCulled{};
+				int nrOutside{};
+				int nrWronglyCulled{};
+				float testTime{};
+				float skippedTime{};
+				for (int view{}; view < nrViews; ++view)
+				{
+					//One after the other, the order arguments are evaluated in isn't fixed
+					const Vector3 origin{ position(random), position(random) * 0.25f, position(random) };
+					const float pitch{ angle(random) * 0.25f };
+					const float yaw{ angle(random) };
+					SetView(renderer, origin, pitch, yaw);
+
+					const auto testStart{ std::chrono::high_resolution_clock::now() };
+					//The same tests Render_Week2 does, the box the scene BVH tests and then the sphere
+					const Frustum frustum{ renderer.m_Camera.GetFrustum() };
+					Vector3 boundsMin{};
+					Vector3 boundsMax{};
+					Renderer::GetWorldBounds(mesh, boundsMin, boundsMax);
+					const bool isCulled{ frustum.IsOutside(boundsMin, boundsMax) || renderer.IsSphereOutsideFrustum(mesh, frustum) };
+					testTime += std::chrono::duration<float, std::micro>{ std::chrono::high_resolution_clock::now() - testStart }.count();
+
+					//Whether culling the triangles one by one leaves any of them
+					renderer.VertexTransformationFunction(mesh, true);
+					bool isOutside{ true };
+					for (size_t triIdx{}; triIdx < mesh.GetTriangleCount() && isOutside; ++triIdx)
+					{
+						uint32_t idx0{}, idx1{}, idx2{};
+						mesh.GetTriangle(triIdx, idx0, idx1, idx2);
+						isOutside = (mesh.clipCodes_out[idx0] & mesh.clipCodes_out[idx1] & mesh.clipCodes_out[idx2] & Clipping::FrustumPlanes) != 0;
+					}
+					nrOutside += isOutside;
+
+					if (!isCulled)
+						continue;
+
+					++nrCulled;
+					nrWronglyCulled += !isOutside;
+
+					//The work the culled mesh doesn't do
+					const auto skippedStart{ std::chrono::high_resolution_clock::now() };
+					renderer.VertexTransformationFunction(mesh, renderer.m_UseLazyVertices);
+					renderer.BinTriangles({ &mesh });
+					skippedTime += std::chrono::duration<float, std::milli>{ std::chrono::high_resolution_clock::now() - skippedStart }.count();
+				}
+
+				char line[256]{};
+				snprintf(line, sizeof(line), "Every triangle outside the frustum in %d views, mesh culled in %d of them (%.1f%%), wrongly culled %d",
+					nrOutside, nrCulled, 100.f * nrCulled / std::max(nrOutside, 1), nrWronglyCulled);
+				std::cout << line << '\n';
+				snprintf(line, sizeof(line), "Bounds test %.2f us per view, vertex stage and binning skipped %.2f ms per culled view",
+					testTime / nrViews, skippedTime / std::max(nrCulled, 1));
+				std::cout << line << '\n';
+			});
+	}
+
+	void Benchmark::RunMeshlets()
+	{
+		struct View
+		{
+			const char* name;
+			Vector3 origin;
+			float yaw;
+			//The dense sphere instead of the vehicle
+			bool isSphere;
+		};
+		const View views[]{
+			{ "front", Vector3{ 0.f, 0.f, -30.f }, 0.f, false },
+			{ "side", Vector3{ -30.f, 0.f, 0.f }, PI * 0.5f, false },
+			{ "near", Vector3{ 0.f, 2.f, -18.f }, 0.f, false },
+			{ "inside", Vector3{ 0.f, 2.f, 0.f }, 0.f, false },
+			{ "sphere", Vector3{ 0.f, 0.f, -30.f }, 0.f, true },
+			{ "sphere near", Vector3{ 0.f, 0.f, -12.f }, 0.f, true } };
+		constexpr int nrFrames{ 50 };
+
+		std::cout << "Meshlet culling benchmark, vehicle and a dense sphere at 640x480, geometry (culling, vertex stage and binning) timed over " << nrFrames << " frames per view\n";
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				Mesh& mesh{ renderer.m_MeshesWorld[1] };
+				const size_t nrPixels{ static_cast<size_t>(renderer.m_Width) * renderer.m_Height };
+
+				//Swapped in place of the vehicle for its views
+				Mesh otherMesh{ CreateSphereMesh(10.f, 256, 512) };
+				std::cout << "Sphere: " << otherMesh.GetTriangleCount() << " triangles, " << otherMesh.meshlets.size() << " meshlets\n";
+				bool isSphereShown{};
+
+				for (const View& view : views)
+				{
+					if (view.isSphere != isSphereShown)
+					{
+						std::swap(mesh, otherMesh);
+						renderer.BuildSceneBVH();
+						isSphereShown = view.isSphere;
+					}
+
+					SetView(renderer, view.origin, 0.f, view.yaw);
+
+					float times[2]{};
+					RenderStats stats[2]{};
+					std::vector<uint32_t> frames[2]{};
+					for (const bool useMeshletCulling : { false, true })
+					{
+						renderer.m_UseMeshletCulling = useMeshletCulling;
+						renderer.Render_Week2();
+						stats[useMeshletCulling] = renderer.GetStats();
+						frames[useMeshletCulling].assign(renderer.m_pBackBufferPixels, renderer.m_pBackBufferPixels + nrPixels);
+
+						//Rasterizing is the same either way, the culled meshlets only save work before it
+						const Frustum frustum{ renderer.m_Camera.GetFrustum() };
+						const auto start{ std::chrono::high_resolution_clock::now() };
+						for (int frame{}; frame < nrFrames; ++frame)
+						{
+							RenderStats culledStats{};
+							if (useMeshletCulling)
+								renderer.CullMeshlets(mesh, frustum, culledStats);
+							else
+								mesh.isVertexVisible_out.clear();
+							renderer.VertexTransformationFunction(mesh, renderer.m_UseLazyVertices);
+							renderer.BinTriangles({ &mesh });
+						}
+						const std::chrono::duration<float, std::milli> elapsed{ std::chrono::high_resolution_clock::now() - start };
+						times[useMeshletCulling] = elapsed.count() / nrFrames;
+					}
+
+					//Every vertex is transformed again, so the culled meshlets can be checked against what the triangles themselves do
+					renderer.m_UseMeshletCulling = false;
+					renderer.Render_Week2();
+					RenderStats meshletStats{};
+					renderer.CullMeshlets(mesh, renderer.m_Camera.GetFrustum(), meshletStats);
+
+					std::vector<bool> isVisible(mesh.meshlets.size(), false);
+					for (const uint32_t meshletIdx : mesh.visibleMeshlets_out)
+					{
+						isVisible[meshletIdx] = true;
+					}
+
+					int nrWronglyCulled{};
+					for (size_t meshletIdx{}; meshletIdx < mesh.meshlets.size(); ++meshletIdx)
+					{
+						if (isVisible[meshletIdx])
+							continue;
+
+						const Meshlet& meshlet{ mesh.meshlets[meshletIdx] };
+						for (uint32_t triIdx{ meshlet.firstTriangle }; triIdx < meshlet.firstTriangle + meshlet.nrTriangles; ++triIdx)
+						{
+							uint32_t idx0{}, idx1{}, idx2{};
+							mesh.GetTriangle(triIdx, idx0, idx1, idx2);
+							const uint16_t codes[3]{ mesh.clipCodes_out[idx0], mesh.clipCodes_out[idx1], mesh.clipCodes_out[idx2] };
+							if ((codes[0] & codes[1] & codes[2] & Clipping::FrustumPlanes) != 0 || ((codes[0] | codes[1] | codes[2]) & Clipping::ClipPlanes) != 0)
+								continue;
+
+							nrWronglyCulled += renderer.CullTriangle(mesh.vertices_out[idx0].position, mesh.vertices_out[idx1].position, mesh.vertices_out[idx2].position, mesh.cullMode)
+								== Renderer::SetupResult::Visible;
+						}
+					}
+
+					const uint32_t nrCulledAnyway{ stats[0].nrFrustumCulled + stats[0].nrFaceCulled };
+					char line[384]{};
+					snprintf(line, sizeof(line), "%-11s meshlets culled %4u of %4zu (%5u triangles outside, %5u facing away, %5.1f%% of what the triangles cull)  wrongly culled %d  geometry %5.2f ms -> %5.2f ms  image %s",
+						view.name, meshletStats.nrMeshletsCulled, mesh.meshlets.size(), meshletStats.nrFrustumCulled, meshletStats.nrFaceCulled,
+						100.f * (meshletStats.nrFrustumCulled + meshletStats.nrFaceCulled) / std::max(nrCulledAnyway, 1u), nrWronglyCulled,
+						times[0], times[1], frames[0] == frames[1] ? "identical" : "DIFFERENT");
+					std::cout << line << '\n';
+				}
+				renderer.m_UseMeshletCulling = true;
+
+				if (isSphereShown)
+					std::swap(mesh, otherMesh);
+			});
+	}
+
+	void Benchmark::RunSceneBVH()
+	{
+		constexpr int nrInstances{ 100000 };
+		constexpr int nrViews{ 500 };
+		//Instances that get a new rotation every frame in the refit test
+		constexpr int nrMovedInstances{ nrInstances / 100 };
+		constexpr int nrRefitFrames{ 100 };
+
+		std::cout << "Scene BVH benchmark, " << nrInstances << " instances of the vehicle bounds from " << nrViews << " random views\n";
+
+		WithRenderer(640, 480, [&](Renderer& renderer)
+			{
+				//Only the bounds of the vehicle, GetWorldBounds reads nothing else
+				Mesh instance{};
+				instance.boundsMin = renderer.m_MeshesWorld[1].boundsMin;
+				instance.boundsMax = renderer.m_MeshesWorld[1].boundsMax;
+				const float spacing{ (instance.boundsMax - instance.boundsMin).Magnitude() };
+				const int nrInstancesPerRow{ static_cast<int>(std::sqrt(static_cast<float>(nrInstances))) + 1 };
+				const float sceneSize{ spacing * nrInstancesPerRow };
+
+				//Same scene and views every run
+				std::mt19937 random{ 1 };
+				std::uniform_real_distribution<float> jitter{ -0.25f * spacing, 0.25f * spacing };
+				std::uniform_real_distribution<float> angle{ -PI, PI };
+				std::uniform_real_distribution<float> position{ 0.f, sceneSize };
+
+				std::vector<Vector3> positions(nrInstances);
+				std::vector<SceneBVH::Item> items(nrInstances);
+				const auto setInstance = [&](int instanceIdx, float yaw)
+					{
+						instance.worldMatrix = Matrix::CreateRotationY(yaw) * Matrix::CreateTranslation(positions[instanceIdx]);
+						Renderer::GetWorldBounds(instance, items[instanceIdx].boundsMin, items[instanceIdx].boundsMax);
+					};
+				for (int instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+				{
+					positions[instanceIdx] = Vector3{ (instanceIdx % nrInstancesPerRow) * spacing + jitter(random), 0.f, (instanceIdx / nrInstancesPerRow) * spacing + jitter(random) };
+					items[instanceIdx].id = static_cast<uint32_t>(instanceIdx);
+					setInstance(instanceIdx, angle(random));
+				}
+
+				SceneBVH bvh{};
+				const auto buildStart{ std::chrono::high_resolution_clock::now() };
+				bvh.Build(items);
+				const std::chrono::duration<float, std::milli> buildTime{ std::chrono::high_resolution_clock::now() - buildStart };
+
+				char line[256]{};
+				snprintf(line, sizeof(line), "Build %.2f ms, %zu nodes, SAH cost %.1f", buildTime.count(), bvh.GetNodeCount(), bvh.GetSAHCost());
+				std::cout << line << '\n';
+
+				std::vector<uint32_t> visibleIds{};
+				std::vector<uint32_t> expectedIds{};
+				float bvhTime{};
+				float loopTime{};
+				size_t nrVisible{};
+				int nrMismatches{};
+				for (int view{}; view < nrViews; ++view)
+				{
+					const Vector3 origin{ position(random), spacing * 0.5f, position(random) };
+					const float pitch{ angle(random) * 0.1f };
+					const float yaw{ angle(random) };
+					SetView(renderer, origin, pitch, yaw);
+					const Frustum frustum{ renderer.m_Camera.GetFrustum() };
+
+					const auto bvhStart{ std::chrono::high_resolution_clock::now() };
+					bvh.Cull(frustum, visibleIds);
+					bvhTime += std::chrono::duration<float, std::micro>{ std::chrono::high_resolution_clock::now() - bvhStart }.count();
+
+					const auto loopStart{ std::chrono::high_resolution_clock::now() };
+					expectedIds.clear();
+					for (const SceneBVH::Item& item : items)
+					{
+						if (!frustum.IsOutside(item.boundsMin, item.boundsMax))
+							expectedIds.push_back(item.id);
+					}
+					loopTime += std::chrono::duration<float, std::micro>{ std::chrono::high_resolution_clock::now() - loopStart }.count();
+
+					std::sort(visibleIds.begin(), visibleIds.end());
+					nrMismatches += visibleIds != expectedIds;
+					nrVisible += visibleIds.size();
+				}
+
+				snprintf(line, sizeof(line), "Cull per view: BVH %.1f us, loop over every box %.1f us (%.0fx), %.1f instances visible, views with different results %d",
+					bvhTime / nrViews, loopTime / nrViews, loopTime / std::max(bvhTime, 1e-3f), static_cast<float>(nrVisible) / nrViews, nrMismatches);
+				std::cout << line << '\n';
+
+				//Moved instances only refit the paths above them, a few percent of the scene costs a fraction of a rebuild
+				std::uniform_int_distribution<int> instanceDistribution{ 0, nrInstances - 1 };
+				for (const int nrMoved : { nrMovedInstances, nrInstances })
+				{
+					float refitTime{};
+					std::vector<int> movedInstances(nrMoved);
+					for (int frame{}; frame < nrRefitFrames; ++frame)
+					{
+						for (int moved{}; moved < nrMoved; ++moved)
+						{
+							movedInstances[moved] = nrMoved == nrInstances ? moved : instanceDistribution(random);
+							setInstance(movedInstances[moved], angle(random));
+						}
+
+						const auto refitStart{ std::chrono::high_resolution_clock::now() };
+						for (const int instanceIdx : movedInstances)
+						{
+							bvh.SetBounds(static_cast<uint32_t>(instanceIdx), items[instanceIdx].boundsMin, items[instanceIdx].boundsMax);
+						}
+						bvh.Refit();
+						refitTime += std::chrono::duration<float, std::milli>{ std::chrono::high_resolution_clock::now() - refitStart }.count();
+					}
+					snprintf(line, sizeof(line), "%6d instances moved per frame: SetBounds and Refit %.3f ms, SAH cost after %d frames %.1f",
+						nrMoved, refitTime / nrRefitFrames, nrRefitFrames, bvh.GetSAHCost());
+					std::cout << line << '\n';
+				}
+
+				//The tree still has to keep exactly the same boxes as the loop after all the refits
+				bvh.Cull(renderer.m_Camera.GetFrustum(), visibleIds);
+				expectedIds.clear();
+				for (const SceneBVH::Item& item : items)
+				{
+					if (!renderer.m_Camera.GetFrustum().IsOutside(item.boundsMin, item.boundsMax))
+						expectedIds.push_back(item.id);
+				}
+				std::sort(visibleIds.begin(), visibleIds.end());
+				std::cout << "Culled after refitting: " << (visibleIds == expectedIds ? "same as the loop" : "DIFFERENT") << '\n';
+			});
+	}
+
+	Mesh Benchmark::CreateSphereMesh(float radius, int nrRings, int nrSegments)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		for (int ring{}; ring <= nrRings; ++ring)
+		{
+			const float theta{ PI * ring / nrRings };
+			for (int segment{}; segment <= nrSegments; ++segment)
+			{
+				const float phi{ 2.f * PI * segment / nrSegments };
+				Vertex vertex{};
+				vertex.normal = Vector3{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				vertex.position = vertex.normal * radius;
+				vertex.tangent = Vector3{ -std::sin(phi), 0.f, std::cos(phi) };
+				vertex.uv = Vector2{ static_cast<float>(segment) / nrSegments, static_cast<float>(ring) / nrRings };
+				vertices.push_back(vertex);
+			}
+		}
+
+		//Clockwise seen from outside
+		const uint32_t rowSize{ static_cast<uint32_t>(nrSegments + 1) };
+		for (uint32_t ring{}; ring < static_cast<uint32_t>(nrRings); ++ring)
+		{
+			for (uint32_t segment{}; segment < static_cast<uint32_t>(nrSegments); ++segment)
+			{
+				const uint32_t topLeft{ ring * rowSize + segment };
+				indices.insert(indices.end(), { topLeft, topLeft + 1, topLeft + rowSize });
+				indices.insert(indices.end(), { topLeft + 1, topLeft + rowSize + 1, topLeft + rowSize });
+			}
+		}
+
+		MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+		MeshOptimizer::BuildMeshlets(vertices, indices, meshlets, meshletVertices);
+
+		Mesh mesh{};
+		mesh.vertexStreams = MeshArray<float>{ MeshCache::CreateVertexStreams(vertices.data(), vertices.size()) };
+		mesh.vertices = MeshArray<Vertex>{ std::move(vertices) };
+		mesh.indices = MeshArray<uint32_t>{ std::move(indices) };
+		mesh.meshlets = MeshArray<Meshlet>{ std::move(meshlets) };
+		mesh.meshletVertices = MeshArray<uint32_t>{ std::move(meshletVertices) };
+		mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+		mesh.boundsMin = Vector3{ -radius, -radius, -radius };
+		mesh.boundsMax = Vector3{ radius, radius, radius };
+		mesh.boundsRadius = radius;
+		mesh.vertices_out.resize(mesh.vertices.size());
+		mesh.clipCodes_out.resize(mesh.vertices.size());
+		return mesh;
+	}
+
+	size_t Benchmark::CountLazyVertices(const Renderer& renderer, const Mesh& mesh)
+	{
+		//Triangles of culled meshlets never get to binning, their vertices aren't even transformed
+		std::vector<bool> isBinned(mesh.GetTriangleCount(), mesh.isVertexVisible_out.empty());
+		for (const uint32_t meshletIdx : mesh.visibleMeshlets_out)
+		{
+			const Meshlet& meshlet{ mesh.meshlets[meshletIdx] };
+			std::fill_n(isBinned.begin() + meshlet.firstTriangle, meshlet.nrTriangles, true);
+		}
+
+		std::vector<bool> isNeeded(mesh.vertices.size(), false);
+		for (size_t triIdx{}; triIdx < mesh.GetTriangleCount(); ++triIdx)
+		{
+			if (!isBinned[triIdx])
+				continue;
+
+			uint32_t indices[3]{};
+			mesh.GetTriangle(triIdx, indices[0], indices[1], indices[2]);
+
+			//Same tests as BinTriangles, clipped triangles need their vertices whatever their facing
+			const uint16_t codes[3]{ mesh.clipCodes_out[indices[0]], mesh.clipCodes_out[indices[1]], mesh.clipCodes_out[indices[2]] };
+			if ((codes[0] & codes[1] & codes[2] & Clipping::FrustumPlanes) != 0)
+				continue;
+
+			if (((codes[0] | codes[1] | codes[2]) & Clipping::ClipPlanes) == 0
+				&& renderer.CullTriangle(mesh.vertices_out[indices[0]].position, mesh.vertices_out[indices[1]].position, mesh.vertices_out[indices[2]].position, mesh.cullMode)
+				!= Renderer::SetupResult::Visible)
+				continue;
+
+			for (const uint32_t index : indices)
+			{
+				isNeeded[index] = true;
+			}
+		}
+
+		return static_cast<size_t>(std::count(isNeeded.begin(), isNeeded.end(), true));
+	}
+
+	Benchmark::CacheMisses Benchmark::SimulateTextureFetches(const Renderer& renderer)
+	{
+		const int width{ renderer.m_Width };
+		const int height{ renderer.m_Height };
+		const Material& material{ *renderer.m_pVehicleMaterial };
+
+		CacheSimulator l1{ 32 * 1024, 8 };
+		CacheSimulator l2{ 1024 * 1024, 16 };
+		CacheMisses misses{};
+
+		//Coverage is replayed on a scratch depth buffer so only the pixels that get shaded sample
+		std::vector<float> depthBuffer(static_cast<size_t>(width) * height, INFINITY);
+
+		for (int tileIdx{}; tileIdx < renderer.m_NrTilesX * renderer.m_NrTilesY; ++tileIdx)
+		{
+			const Int2 tileMin{ (tileIdx % renderer.m_NrTilesX) * Renderer::TileSize, (tileIdx / renderer.m_NrTilesX) * Renderer::TileSize };
+			const Int2 tileMax{ std::min(tileMin.x + Renderer::TileSize, width) - 1, std::min(tileMin.y + Renderer::TileSize, height) - 1 };
+
+			for (const Renderer::BinChunk& chunk : renderer.m_BinChunks)
+			{
+				for (const uint32_t triIdx : chunk.tileBins[tileIdx])
+				{
+					const TriangleSetup& triangle{ chunk.triangles[triIdx] };
+					Coverage::TraverseBlocks(renderer.m_TraversalOrder, triangle, tileMin, tileMax, [&](int bx, int by)
+						{
+							uint32_t mask{ Coverage::TestBlock_Scalar(triangle, bx, by, depthBuffer.data(), width, Coverage::GetValidMask(bx, by, tileMax)) };
+							while (mask != 0)
+							{
+								const int lane{ std::countr_zero(mask) };
+								mask &= mask - 1;
+
+								//Same uv and derivatives as Renderer::InterpolatePixel
+								const float dx{ static_cast<float>(bx + lane % Coverage::BlockWidth - triangle.min.x) };
+								const float dy{ static_cast<float>(by + lane / Coverage::BlockWidth - triangle.min.y) };
+								const float w{ 1.f / triangle.invW.Evaluate(dx, dy) };
+								const Vector2 uv{ Vector2{ triangle.uv[0].Evaluate(dx, dy), triangle.uv[1].Evaluate(dx, dy) } * w };
+								const Vector2 uvDx{ (Vector2{ triangle.uv[0].stepX, triangle.uv[1].stepX } - uv * triangle.invW.stepX) * w };
+								const Vector2 uvDy{ (Vector2{ triangle.uv[0].stepY, triangle.uv[1].stepY } - uv * triangle.invW.stepY) * w };
+
+								uint64_t addresses[8]{};
+								const int nrTexels{ GetTrilinearTexels(material, uv, uvDx, uvDy, addresses) };
+								for (int texelIdx{}; texelIdx < nrTexels; ++texelIdx)
+								{
+									//A texel can straddle two cache lines
+									const uint64_t first{ addresses[texelIdx] };
+									const uint64_t last{ first + sizeof(Material::Texel) - 1 };
+									for (uint64_t address{ first }; address <= last; address = (address / CacheSimulator::LineSize + 1) * CacheSimulator::LineSize)
+									{
+										++misses.accesses;
+										if (l1.Access(address))
+											continue;
+
+										++misses.l1;
+										if (!l2.Access(address))
+											++misses.l2;
+									}
+								}
+							}
+						});
+				}
+			}
+		}
+
+		return misses;
+	}
+
+	int Benchmark::GetTrilinearTexels(const Material& material, const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, uint64_t (&addresses)[8])
+	{
+		const float lod{ Texture::GetLod(uvDx, uvDy, material.m_Width, material.m_Height, material.m_MipLevels.size()) };
+		const size_t firstLevel{ static_cast<size_t>(lod) };
+		const size_t nrLevels{ lod > static_cast<float>(firstLevel) ? 2u : 1u };
+
+		int count{};
+		for (size_t levelIdx{ firstLevel }; levelIdx < firstLevel + nrLevels; ++levelIdx)
+		{
+			//Same footprint as Material::SampleBilinear
+			const Material::MipLevel& level{ material.m_MipLevels[levelIdx] };
+			const int x{ static_cast<int>(std::floor(uv.x * level.width - 0.5f)) };
+			const int y{ static_cast<int>(std::floor(uv.y * level.height - 0.5f)) };
+			const int x0{ std::clamp(x, 0, level.width - 1) };
+			const int y0{ std::clamp(y, 0, level.height - 1) };
+			const int x1{ std::clamp(x + 1, 0, level.width - 1) };
+			const int y1{ std::clamp(y + 1, 0, level.height - 1) };
+
+			for (const Int2& texel : { Int2{ x0, y0 }, Int2{ x1, y0 }, Int2{ x0, y1 }, Int2{ x1, y1 } })
+			{
+				addresses[count++] = reinterpret_cast<uint64_t>(level.pTexels + material.GetTexelIndex(level, texel.x, texel.y));
+			}
+		}
+
+		return count;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace dae
+{
+	class Renderer;
+	class Material;
+	struct Vector2;
+	struct Vector3;
+	struct Mesh;
+
+	//Offline measurements, started with "--benchmark <name>" instead of opening the interactive window
+	class Benchmark final
+	{
+	public:
+		//Returns false if there is no benchmark with that name
+		static bool Run(const std::string& name);
+
+		//Renders the vehicle at several resolutions with every Coverage::TraversalOrder
+		//Prints the frame time and the L1/L2 misses of a simulated cache on the depth and color buffers
+		static void RunTraversal();
+
+		//Renders a full turn of the vehicle with every TextureLayout
+		//Prints the frame time and the L1/L2 misses of a simulated cache on the texels the vehicle material reads
+		static void RunTextureLayout();
+
+		//Renders a full turn of the vehicle with the uncompressed and the block compressed material
+		//Prints the memory of the material, its load time, the frame time and the PSNR of the frames against the uncompressed ones
+		static void RunTextureCompression();
+
+		//Loads every OBJ with Utils::ParseOBJ and with ObjParser, single threaded and on a ThreadPool
+		//Prints the fastest time of each and whether ObjParser gave the exact same vertices and indices
+		static void RunObjLoad();
+
+		//Loads every OBJ with and without ObjParser's vertex welding
+		//Prints the vertex counts and the fastest VertexTransformationFunction time of each
+		static void RunVertexWelding();
+
+		//Loads every OBJ by parsing it, by parsing it and writing its MeshCache file, and from that cache file
+		//Prints the ACMR before and after MeshOptimizer, the fastest time of each and whether the mapped mesh is the exact same as the parsed and optimized one
+		static void RunMeshCache();
+
+		//Transforms 2 million vertices with the scalar loop and with the SoA AVX2 path, each on one thread and on the renderer's ThreadPool
+		//Prints the fastest time of each and whether both paths gave the exact same vertices_out and clip codes
+		static void RunVertexStage();
+
+		//Renders the vehicle from outside, close by and from inside with and without lazy vertices
+		//Prints the fraction of vertices no surviving triangle references, the lazy transformations, the frame times and whether both images are the same
+		static void RunLazyVertices();
+
+		//Points the camera in random directions from random places around the vehicle
+		//Prints how often the mesh is culled as a whole against how often all its triangles are outside the frustum, and what a culled mesh saves
+		static void RunFrustumCulling();
+
+		//Renders the vehicle from a few views with and without meshlet culling
+		//Prints how many meshlets the frustum and the normal cones reject, whether that ever rejects a triangle that would be drawn, and the time spent before rasterizing
+		static void RunMeshlets();
+
+		//Culls 100k instances of the vehicle bounds spread over a large plane with the scene BVH and with a loop over every box
+		//Prints the build time and SAH cost, the time of both per view, whether they keep the same boxes, and what refitting moved instances costs
+		static void RunSceneBVH();
+
+	private:
+		struct CacheMisses
+		{
+			uint64_t accesses{};
+			uint64_t l1{};
+			uint64_t l2{};
+		};
+
+		//Hidden window of that size with a Renderer on it, rotation stopped after one update, passed to run and destroyed afterwards
+		//Does nothing if the window can't be created
+		static void WithRenderer(int width, int height, const std::function<void(Renderer&)>& run);
+		//Camera at origin looking along pitch and yaw, in radians
+		static void SetView(Renderer& renderer, const Vector3& origin, float pitch, float yaw);
+		//UV sphere around the origin with 2 * nrRings * nrSegments triangles, split into meshlets like MeshCache does
+		static Mesh CreateSphereMesh(float radius, int nrRings, int nrSegments);
+		//Vertices referenced by a triangle of the last rendered frame that survived culling, the ones lazy vertices transform at least once
+		static size_t CountLazyVertices(const Renderer& renderer, const Mesh& mesh);
+		//Replays the buffer accesses of the last rendered frame as one core would do them, tile by tile
+		static CacheMisses SimulateTraversal(const Renderer& renderer);
+		//Replays the texel reads of the last rendered frame, tile by tile
+		static CacheMisses SimulateTextureFetches(const Renderer& renderer);
+		//Addresses of the texels a trilinear sample reads, returns how many there are (4 or 8)
+		static int GetTrilinearTexels(const Material& material, const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, uint64_t (&addresses)[8]);
+	};
+}
@@ -0,0 +1,303 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	namespace BlockCompression
+	{
+		static uint16_t PackRGB565(int r, int g, int b)
+		{
+			return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+		}
+
+		//Bits are replicated into the low end, so 0 and 31/63 become exactly 0 and 255
+		static void UnpackRGB565(uint16_t color, int (&rgb)[3])
+		{
+			const int r{ (color >> 11) & 0x1F };
+			const int g{ (color >> 5) & 0x3F };
+			const int b{ color & 0x1F };
+			rgb[0] = (r << 3) | (r >> 2);
+			rgb[1] = (g << 2) | (g >> 4);
+			rgb[2] = (b << 3) | (b >> 2);
+		}
+
+		static int GetChannel(uint32_t texel, int channel)
+		{
+			return (texel >> (channel * 8)) & 0xFF;
+		}
+
+		//The 4 colors of a color block, with transparent black last in the 3 color mode
+		//The color block of BC3 always uses 4 colors, only BC1 looks at the endpoint order
+		static void GetPalette(uint16_t color0, uint16_t color1, bool allowThreeColors, uint32_t (&palette)[4])
+		{
+			int endpoints[2][3]{};
+			UnpackRGB565(color0, endpoints[0]);
+			UnpackRGB565(color1, endpoints[1]);
+
+			const bool hasFourColors{ color0 > color1 || !allowThreeColors };
+			for (int idx{}; idx < 4; ++idx)
+			{
+				palette[idx] = 0xFF000000;
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+			{
+				const int a{ endpoints[0][channel] };
+				const int b{ endpoints[1][channel] };
+				const int shift{ channel * 8 };
+
+				palette[0] |= a << shift;
+				palette[1] |= b << shift;
+				if (hasFourColors)
+				{
+					palette[2] |= ((2 * a + b) / 3) << shift;
+					palette[3] |= ((a + 2 * b) / 3) << shift;
+				}
+				else
+				{
+					palette[2] |= ((a + b) / 2) << shift;
+				}
+			}
+
+			if (!hasFourColors)
+				palette[3] = 0;
+		}
+
+		static void EncodeColorBlock(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock)
+		{
+			//Bounding box of the colors, shrunk a bit so the endpoints aren't pulled out by a single extreme texel
+			int minColor[3]{ 255, 255, 255 };
+			int maxColor[3]{};
+			for (const uint32_t texel : texels)
+			{
+				for (int channel{}; channel < 3; ++channel)
+				{
+					minColor[channel] = std::min(minColor[channel], GetChannel(texel, channel));
+					maxColor[channel] = std::max(maxColor[channel], GetChannel(texel, channel));
+				}
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+			{
+				const int inset{ (maxColor[channel] - minColor[channel]) / 16 };
+				minColor[channel] += inset;
+				maxColor[channel] -= inset;
+			}
+
+			//The box has 4 diagonals, pick the one that follows how red and blue change with green
+			int center[3]{};
+			for (int channel{}; channel < 3; ++channel)
+			{
+				center[channel] = (minColor[channel] + maxColor[channel]) / 2;
+			}
+
+			int covarianceRG{};
+			int covarianceBG{};
+			for (const uint32_t texel : texels)
+			{
+				const int g{ GetChannel(texel, 1) - center[1] };
+				covarianceRG += (GetChannel(texel, 0) - center[0]) * g;
+				covarianceBG += (GetChannel(texel, 2) - center[2]) * g;
+			}
+
+			if (covarianceRG < 0)
+				std::swap(minColor[0], maxColor[0]);
+			if (covarianceBG < 0)
+				std::swap(minColor[2], maxColor[2]);
+
+			uint16_t color0{ PackRGB565(maxColor[0], maxColor[1], maxColor[2]) };
+			uint16_t color1{ PackRGB565(minColor[0], minColor[1], minColor[2]) };
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			uint32_t indices{};
+			//Equal endpoints would select the 3 color mode, every texel gets color0 instead
+			if (color0 != color1)
+			{
+				uint32_t palette[4]{};
+				GetPalette(color0, color1, false, palette);
+
+				for (int texelIdx{}; texelIdx < TexelsPerBlock; ++texelIdx)
+				{
+					int bestIdx{};
+					int bestError{ INT32_MAX };
+					for (int paletteIdx{}; paletteIdx < 4; ++paletteIdx)
+					{
+						int error{};
+						for (int channel{}; channel < 3; ++channel)
+						{
+							const int difference{ GetChannel(texels[texelIdx], channel) - GetChannel(palette[paletteIdx], channel) };
+							error += difference * difference;
+						}
+
+						if (error < bestError)
+						{
+							bestError = error;
+							bestIdx = paletteIdx;
+						}
+					}
+
+					indices |= static_cast<uint32_t>(bestIdx) << (texelIdx * 2);
+				}
+			}
+
+			//Everything is little endian
+			pBlock[0] = static_cast<uint8_t>(color0);
+			pBlock[1] = static_cast<uint8_t>(color0 >> 8);
+			pBlock[2] = static_cast<uint8_t>(color1);
+			pBlock[3] = static_cast<uint8_t>(color1 >> 8);
+			for (int byte{}; byte < 4; ++byte)
+			{
+				pBlock[4 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+			}
+		}
+
+		static void DecodeColorBlock(const uint8_t* pBlock, bool allowThreeColors, uint32_t (&texels)[TexelsPerBlock])
+		{
+			const uint16_t color0{ static_cast<uint16_t>(pBlock[0] | pBlock[1] << 8) };
+			const uint16_t color1{ static_cast<uint16_t>(pBlock[2] | pBlock[3] << 8) };
+			uint32_t palette[4]{};
+			GetPalette(color0, color1, allowThreeColors, palette);
+
+			const uint32_t indices{ static_cast<uint32_t>(pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16 | pBlock[7] << 24) };
+			for (int texelIdx{}; texelIdx < TexelsPerBlock; ++texelIdx)
+			{
+				texels[texelIdx] = palette[(indices >> (texelIdx * 2)) & 3];
+			}
+		}
+
+		//The 8 values of a single channel block, the 6 value mode adds 0 and 255 at the end
+		static void GetChannelPalette(int value0, int value1, int (&palette)[8])
+		{
+			palette[0] = value0;
+			palette[1] = value1;
+			if (value0 > value1)
+			{
+				for (int idx{ 1 }; idx < 7; ++idx)
+				{
+					palette[idx + 1] = ((7 - idx) * value0 + idx * value1) / 7;
+				}
+			}
+			else
+			{
+				for (int idx{ 1 }; idx < 5; ++idx)
+				{
+					palette[idx + 1] = ((5 - idx) * value0 + idx * value1) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+		}
+
+		//The alpha block of BC3 and both halves of BC5, values are taken from the byte at shift
+		static void EncodeChannelBlock(const uint32_t (&texels)[TexelsPerBlock], int shift, uint8_t* pBlock)
+		{
+			int minValue{ 255 };
+			int maxValue{};
+			for (const uint32_t texel : texels)
+			{
+				const int value{ static_cast<int>((texel >> shift) & 0xFF) };
+				minValue = std::min(minValue, value);
+				maxValue = std::max(maxValue, value);
+			}
+
+			uint64_t indices{};
+			if (maxValue != minValue)
+			{
+				int palette[8]{};
+				GetChannelPalette(maxValue, minValue, palette);
+
+				for (int texelIdx{}; texelIdx < TexelsPerBlock; ++texelIdx)
+				{
+					const int value{ static_cast<int>((texels[texelIdx] >> shift) & 0xFF) };
+
+					int bestIdx{};
+					for (int paletteIdx{ 1 }; paletteIdx < 8; ++paletteIdx)
+					{
+						if (std::abs(palette[paletteIdx] - value) < std::abs(palette[bestIdx] - value))
+							bestIdx = paletteIdx;
+					}
+
+					indices |= static_cast<uint64_t>(bestIdx) << (texelIdx * 3);
+				}
+			}
+
+			pBlock[0] = static_cast<uint8_t>(maxValue);
+			pBlock[1] = static_cast<uint8_t>(minValue);
+			for (int byte{}; byte < 6; ++byte)
+			{
+				pBlock[2 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+			}
+		}
+
+		//Writes the byte at shift, the others are left as they are
+		static void DecodeChannelBlock(const uint8_t* pBlock, int shift, uint32_t (&texels)[TexelsPerBlock])
+		{
+			int palette[8]{};
+			GetChannelPalette(pBlock[0], pBlock[1], palette);
+
+			uint64_t indices{};
+			for (int byte{}; byte < 6; ++byte)
+			{
+				indices |= static_cast<uint64_t>(pBlock[2 + byte]) << (byte * 8);
+			}
+
+			const uint32_t mask{ ~(0xFFu << shift) };
+			for (int texelIdx{}; texelIdx < TexelsPerBlock; ++texelIdx)
+			{
+				const uint32_t value{ static_cast<uint32_t>(palette[(indices >> (texelIdx * 3)) & 7]) };
+				texels[texelIdx] = (texels[texelIdx] & mask) | (value << shift);
+			}
+		}
+
+		void EncodeBC1(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock)
+		{
+			EncodeColorBlock(texels, pBlock);
+		}
+
+		void EncodeBC3(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock)
+		{
+			EncodeChannelBlock(texels, 24, pBlock);
+			EncodeColorBlock(texels, pBlock + 8);
+		}
+
+		void EncodeBC5(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock)
+		{
+			EncodeChannelBlock(texels, 0, pBlock);
+			EncodeChannelBlock(texels, 8, pBlock + 8);
+		}
+
+		void DecodeBC1(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock])
+		{
+			DecodeColorBlock(pBlock, true, texels);
+		}
+
+		void DecodeBC3(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock])
+		{
+			DecodeColorBlock(pBlock + 8, false, texels);
+			DecodeChannelBlock(pBlock, 24, texels);
+		}
+
+		void DecodeBC5(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock])
+		{
+			for (uint32_t& texel : texels)
+			{
+				texel = 0xFF000000;
+			}
+
+			DecodeChannelBlock(pBlock, 0, texels);
+			DecodeChannelBlock(pBlock + 8, 8, texels);
+
+			//Stored as 0.5 + 0.5 * n, like the rgb normal map it came from
+			for (uint32_t& texel : texels)
+			{
+				const float x{ GetChannel(texel, 0) / 127.5f - 1.f };
+				const float y{ GetChannel(texel, 1) / 127.5f - 1.f };
+				const float z{ std::sqrt(std::max(1.f - x * x - y * y, 0.f)) };
+				texel |= static_cast<uint32_t>((z + 1.f) * 127.5f + 0.5f) << 16;
+			}
+		}
+	}
+}
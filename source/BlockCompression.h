@@ -0,0 +1,64 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+
+namespace dae
+{
+	//Encoders and decoders for the 4x4 block formats
+	//Texels are packed like Texture's, r in the lowest byte and a in the highest
+	namespace BlockCompression
+	{
+		constexpr int BlockSize{ 4 };
+		constexpr int TexelsPerBlock{ BlockSize * BlockSize };
+
+		//BC1 is rgb in 8 bytes, BC3 adds a separate alpha block, BC5 is r and g as two independent channels
+		constexpr int BC1BlockBytes{ 8 };
+		constexpr int BC3BlockBytes{ 16 };
+		constexpr int BC5BlockBytes{ 16 };
+
+		//Texel (x, y) of a block is texels[y * BlockSize + x]
+		void EncodeBC1(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock);
+		void EncodeBC3(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock);
+		//Only r and g are kept, meant for tangent space normal maps
+		void EncodeBC5(const uint32_t (&texels)[TexelsPerBlock], uint8_t* pBlock);
+
+		//Alpha is 255, except for the transparent black of the 3 color mode, which EncodeBC1 never writes
+		void DecodeBC1(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock]);
+		void DecodeBC3(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock]);
+		//Blue is reconstructed as z of the unit normal (r, g, z), alpha is 255
+		void DecodeBC5(const uint8_t* pBlock, uint32_t (&texels)[TexelsPerBlock]);
+
+		//Small direct mapped cache of decoded blocks, meant to be thread_local so sampling needs no locks
+		//Keys have to be unique over every block of every live texture
+		template<typename Texel, int NrEntries>
+		class DecodedBlockCache final
+		{
+		public:
+			static_assert(NrEntries > 1 && (NrEntries & (NrEntries - 1)) == 0, "NrEntries has to be a power of two above 1");
+
+			//decode(texels) is only called on a miss
+			template<typename DecodeFunction>
+			const Texel* Get(uint64_t key, DecodeFunction&& decode)
+			{
+				//Fibonacci hashing, so the blocks above and below don't land in the same entry for power of two widths
+				Entry& entry{ m_Entries[(key * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(static_cast<unsigned>(NrEntries)))] };
+				if (entry.key != key)
+				{
+					decode(entry.texels);
+					entry.key = key;
+				}
+
+				return entry.texels;
+			}
+
+		private:
+			struct Entry
+			{
+				uint64_t key{ UINT64_MAX };
+				Texel texels[TexelsPerBlock]{};
+			};
+
+			Entry m_Entries[NrEntries]{};
+		};
+	}
+}
@@ -3,6 +3,7 @@
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
 
+#include "Frustum.h"
 #include "Math.h"
 #include "Timer.h"
 
@@ -72,6 +73,12 @@ namespace dae
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
 		}
 
+		//World space planes of what the view and projection matrices keep
+		Frustum GetFrustum() const
+		{
+			return Frustum::FromViewProjection(invViewMatrix * projectionMatrix);
+		}
+
 		void Update(Timer* pTimer)
 		{
 			const float deltaTime = pTimer->GetElapsed();
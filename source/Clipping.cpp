@@ -0,0 +1,108 @@
+#include "Clipping.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	namespace Clipping
+	{
+		//Signed distance to the plane, positive is inside
+		static float GetDistance(const Vector4& p, uint16_t plane)
+		{
+			switch (plane)
+			{
+			case Near:
+				return p.z;
+			case Far:
+				return p.w - p.z;
+			case GuardBandLeft:
+				return p.x + GuardBand * p.w;
+			case GuardBandRight:
+				return GuardBand * p.w - p.x;
+			case GuardBandBottom:
+				return p.y + GuardBand * p.w;
+			case GuardBandTop:
+				return GuardBand * p.w - p.y;
+			default:
+				return 0.f;
+			}
+		}
+
+		static ClipVertex Interpolate(const ClipVertex& v0, const ClipVertex& v1, float t)
+		{
+			const Vertex_Out& a{ v0.vertex };
+			const Vertex_Out& b{ v1.vertex };
+
+			ClipVertex result{};
+			result.position = v0.position + (v1.position - v0.position) * t;
+			result.vertex.color = ColorRGB::Lerp(a.color, b.color, t);
+			result.vertex.uv = a.uv + (b.uv - a.uv) * t;
+			result.vertex.normal = a.normal + (b.normal - a.normal) * t;
+			result.vertex.tangent = a.tangent + (b.tangent - a.tangent) * t;
+			result.vertex.viewDirection = a.viewDirection + (b.viewDirection - a.viewDirection) * t;
+			return result;
+		}
+
+		uint16_t GetClipCode(const Vector4& p)
+		{
+			uint16_t code{};
+
+			if (p.z < 0.f) code |= Near;
+			if (p.z > p.w) code |= Far;
+			if (p.x < -p.w) code |= Left;
+			if (p.x > p.w) code |= Right;
+			if (p.y < -p.w) code |= Bottom;
+			if (p.y > p.w) code |= Top;
+
+			const float guardBandW{ GuardBand * p.w };
+			if (p.x < -guardBandW) code |= GuardBandLeft;
+			if (p.x > guardBandW) code |= GuardBandRight;
+			if (p.y < -guardBandW) code |= GuardBandBottom;
+			if (p.y > guardBandW) code |= GuardBandTop;
+
+			return code;
+		}
+
+		int ClipTriangle(const ClipVertex (&triangle)[3], uint16_t clipPlanes, ClipVertex* pOut)
+		{
+			ClipVertex polygons[2][MaxClippedVertices]{};
+			std::copy(std::begin(triangle), std::end(triangle), polygons[0]);
+			int count{ 3 };
+			int current{};
+
+			//Near goes first, after that every vertex has a positive w
+			for (uint16_t plane{ Near }; plane <= GuardBandTop; plane <<= 1)
+			{
+				if ((clipPlanes & plane) == 0 || (ClipPlanes & plane) == 0)
+					continue;
+
+				const ClipVertex* pSource{ polygons[current] };
+				ClipVertex* pDestination{ polygons[current ^ 1] };
+				int newCount{};
+
+				for (int idx{}; idx < count; ++idx)
+				{
+					const ClipVertex& start{ pSource[idx] };
+					const ClipVertex& end{ pSource[(idx + 1) % count] };
+					const float startDistance{ GetDistance(start.position, plane) };
+					const float endDistance{ GetDistance(end.position, plane) };
+
+					if (startDistance >= 0.f)
+						pDestination[newCount++] = start;
+
+					if ((startDistance >= 0.f) != (endDistance >= 0.f))
+						pDestination[newCount++] = Interpolate(start, end, startDistance / (startDistance - endDistance));
+				}
+
+				count = newCount;
+				current ^= 1;
+
+				if (count < 3)
+					return 0;
+			}
+
+			std::copy(polygons[current], polygons[current] + count, pOut);
+			return count;
+		}
+	}
+}
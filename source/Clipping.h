@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace Clipping
+	{
+		//One bit per plane the clip space position is outside of
+		enum ClipCode : uint16_t
+		{
+			Near = 1 << 0,
+			Far = 1 << 1,
+			Left = 1 << 2,
+			Right = 1 << 3,
+			Bottom = 1 << 4,
+			Top = 1 << 5,
+			GuardBandLeft = 1 << 6,
+			GuardBandRight = 1 << 7,
+			GuardBandBottom = 1 << 8,
+			GuardBandTop = 1 << 9
+		};
+
+		//Triangles completely outside one of these are culled
+		constexpr uint16_t FrustumPlanes{ Near | Far | Left | Right | Bottom | Top };
+		//Only these are actually clipped against, anything between the frustum and the guard band is left to the rasterizer
+		constexpr uint16_t ClipPlanes{ Near | Far | GuardBandLeft | GuardBandRight | GuardBandBottom | GuardBandTop };
+
+		//Guard band is this many times the size of the viewport, keeps the screen coordinates of unclipped triangles in a sane range
+		constexpr float GuardBand{ 8.f };
+
+		//Every clipped plane adds at most one vertex
+		constexpr int MaxClippedVertices{ 3 + 6 };
+
+		struct ClipVertex
+		{
+			Vector4 position{};
+			Vertex_Out vertex{};
+		};
+
+		uint16_t GetClipCode(const Vector4& clipPosition);
+
+		//Sutherland-Hodgman against the planes set in clipPlanes, attributes are interpolated linearly in clip space
+		//Returns the vertex count of the resulting convex polygon in pOut, less than 3 means nothing is left
+		int ClipTriangle(const ClipVertex (&triangle)[3], uint16_t clipPlanes, ClipVertex* pOut);
+	}
+}
@@ -0,0 +1,154 @@
+#include "Coverage.h"
+
+#include <immintrin.h>
+
+#include "CpuFeatures.h"
+
+namespace dae
+{
+	namespace Coverage
+	{
+		uint32_t TestBlock_AVX2(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width)
+		{
+			//Edges are 64 bit, so every edge takes one register per block row
+			__m256i inside0{ _mm256_set1_epi64x(-1) };
+			__m256i inside1{ inside0 };
+			for (int edge{}; edge < 3; ++edge)
+			{
+				const int64_t stepX{ triangle.edgeStepX[edge] };
+				const __m256i row0{ _mm256_add_epi64(_mm256_set1_epi64x(triangle.GetEdge(edge, x, y)), _mm256_set_epi64x(3 * stepX, 2 * stepX, stepX, 0)) };
+				const __m256i row1{ _mm256_add_epi64(row0, _mm256_set1_epi64x(triangle.edgeStepY[edge])) };
+				inside0 = _mm256_and_si256(inside0, row0);
+				inside1 = _mm256_and_si256(inside1, row1);
+			}
+
+			//Only the sign bits are needed, a pixel is inside when all three edges are negative
+			const uint32_t coverage{ static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(inside0)) | (_mm256_movemask_pd(_mm256_castsi256_pd(inside1)) << 4)) };
+			if (coverage == 0)
+				return 0;
+
+			const __m256 dx{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x - triangle.min.x)), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 0.f, 1.f, 2.f, 3.f)) };
+			const __m256 dy{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(y - triangle.min.y)), _mm256_setr_ps(0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f)) };
+			__m256 depth{ _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(triangle.depth.origin),
+				_mm256_mul_ps(_mm256_set1_ps(triangle.depth.stepX), dx)),
+				_mm256_mul_ps(_mm256_set1_ps(triangle.depth.stepY), dy)) };
+			depth = _mm256_min_ps(_mm256_max_ps(depth, _mm256_set1_ps(triangle.minDepth)), _mm256_set1_ps(triangle.maxDepth));
+
+			float* pRow0{ pDepthBuffer + y * width + x };
+			float* pRow1{ pRow0 + width };
+			const __m256 oldDepth{ _mm256_set_m128(_mm_loadu_ps(pRow1), _mm_loadu_ps(pRow0)) };
+
+			const uint32_t pass{ coverage & static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(depth, oldDepth, _CMP_LT_OQ))) };
+			if (pass == 0)
+				return 0;
+
+			const __m256i laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+			const __m256i passLanes{ _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(pass)), laneBits), laneBits) };
+			const __m256 newDepth{ _mm256_blendv_ps(oldDepth, depth, _mm256_castsi256_ps(passLanes)) };
+
+			_mm_storeu_ps(pRow0, _mm256_castps256_ps128(newDepth));
+			_mm_storeu_ps(pRow1, _mm256_extractf128_ps(newDepth, 1));
+
+			return pass;
+		}
+
+		uint32_t TestBlock_SSE41(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width)
+		{
+			const __m128 dx{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x - triangle.min.x)), _mm_setr_ps(0.f, 1.f, 2.f, 3.f)) };
+			const __m128i laneBits{ _mm_setr_epi32(1, 2, 4, 8) };
+
+			uint32_t mask{};
+			for (int ly{}; ly < BlockHeight; ++ly)
+			{
+				//Two 64 bit lanes per register, so the row is split in a left and a right half
+				__m128i insideLeft{ _mm_set1_epi64x(-1) };
+				__m128i insideRight{ insideLeft };
+				for (int edge{}; edge < 3; ++edge)
+				{
+					const int64_t stepX{ triangle.edgeStepX[edge] };
+					const __m128i left{ _mm_add_epi64(_mm_set1_epi64x(triangle.GetEdge(edge, x, y + ly)), _mm_set_epi64x(stepX, 0)) };
+					const __m128i right{ _mm_add_epi64(left, _mm_set1_epi64x(2 * stepX)) };
+					insideLeft = _mm_and_si128(insideLeft, left);
+					insideRight = _mm_and_si128(insideRight, right);
+				}
+
+				const uint32_t coverage{ static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(insideLeft)) | (_mm_movemask_pd(_mm_castsi128_pd(insideRight)) << 2)) };
+				if (coverage == 0)
+					continue;
+
+				const __m128 dy{ _mm_set1_ps(static_cast<float>(y + ly - triangle.min.y)) };
+				__m128 depth{ _mm_add_ps(_mm_add_ps(_mm_set1_ps(triangle.depth.origin),
+					_mm_mul_ps(_mm_set1_ps(triangle.depth.stepX), dx)),
+					_mm_mul_ps(_mm_set1_ps(triangle.depth.stepY), dy)) };
+				depth = _mm_min_ps(_mm_max_ps(depth, _mm_set1_ps(triangle.minDepth)), _mm_set1_ps(triangle.maxDepth));
+
+				float* pRow{ pDepthBuffer + (y + ly) * width + x };
+				const __m128 oldDepth{ _mm_loadu_ps(pRow) };
+
+				const uint32_t pass{ coverage & static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(depth, oldDepth))) };
+				if (pass == 0)
+					continue;
+
+				const __m128i passLanes{ _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(pass)), laneBits), laneBits) };
+				_mm_storeu_ps(pRow, _mm_blendv_ps(oldDepth, depth, _mm_castsi128_ps(passLanes)));
+
+				mask |= pass << (ly * BlockWidth);
+			}
+
+			return mask;
+		}
+
+		uint32_t TestBlock_Scalar(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width, uint32_t validMask)
+		{
+			uint32_t mask{};
+			for (int lane{}; lane < BlockWidth * BlockHeight; ++lane)
+			{
+				if ((validMask & (1u << lane)) == 0)
+					continue;
+
+				const int px{ x + lane % BlockWidth };
+				const int py{ y + lane / BlockWidth };
+
+				//Fill rule is part of the edge origins, inside means all three are negative
+				if ((triangle.GetEdge(0, px, py) & triangle.GetEdge(1, px, py) & triangle.GetEdge(2, px, py)) >= 0)
+					continue;
+
+				//Same evaluation order as the SIMD versions so all of them agree bit for bit
+				float depth{ triangle.depth.Evaluate(static_cast<float>(px - triangle.min.x), static_cast<float>(py - triangle.min.y)) };
+				depth = std::min(std::max(depth, triangle.minDepth), triangle.maxDepth);
+
+				float& storedDepth{ pDepthBuffer[px + py * width] };
+				if (depth < storedDepth)
+				{
+					storedDepth = depth;
+					mask |= 1u << lane;
+				}
+			}
+
+			return mask;
+		}
+
+		BlockFunction SelectBlockFunction()
+		{
+			if (CpuFeatures::HasAVX2())
+				return TestBlock_AVX2;
+			if (CpuFeatures::HasSSE41())
+				return TestBlock_SSE41;
+
+			return [](const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width)
+				{
+					return TestBlock_Scalar(triangle, x, y, pDepthBuffer, width);
+				};
+		}
+
+		const char* GetBlockFunctionName(BlockFunction blockFunction)
+		{
+			if (blockFunction == TestBlock_AVX2)
+				return "AVX2";
+			if (blockFunction == TestBlock_SSE41)
+				return "SSE4.1";
+
+			return "Scalar";
+		}
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace Coverage
+	{
+		//Pixels are tested in blocks of BlockWidth x BlockHeight, one SIMD lane per pixel
+		//Bit (ly * BlockWidth + lx) of a block mask belongs to the pixel at (x + lx, y + ly)
+		constexpr int BlockWidth{ 4 };
+		constexpr int BlockHeight{ 2 };
+		constexpr uint32_t FullBlockMask{ (1u << (BlockWidth * BlockHeight)) - 1 };
+
+		//Tests coverage and depth of the block at (x, y), stores the depth of the passing pixels and returns their mask
+		//The whole block has to lie inside the depth buffer
+		using BlockFunction = uint32_t(*)(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width);
+
+		uint32_t TestBlock_AVX2(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width);
+		uint32_t TestBlock_SSE41(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width);
+
+		//Reference version, only touches the pixels in validMask so it can be used on blocks that stick out of the screen
+		uint32_t TestBlock_Scalar(const TriangleSetup& triangle, int x, int y, float* pDepthBuffer, int width, uint32_t validMask = FullBlockMask);
+
+		//Marks the lanes of the block at (x, y) that lie inside max (inclusive)
+		inline uint32_t GetValidMask(int x, int y, const Int2& max)
+		{
+			if (x + BlockWidth - 1 <= max.x && y + BlockHeight - 1 <= max.y)
+				return FullBlockMask;
+
+			uint32_t validMask{};
+			for (int lane{}; lane < BlockWidth * BlockHeight; ++lane)
+			{
+				if (x + lane % BlockWidth <= max.x && y + lane / BlockWidth <= max.y)
+					validMask |= 1u << lane;
+			}
+			return validMask;
+		}
+
+		//Order in which the blocks of a triangle are visited
+		enum class TraversalOrder
+		{
+			ColumnMajor, //Column by column, strides through the buffers by the screen width every step
+			RowMajor, //Follows memory order
+			Blocked //TraversalBlockSize squares in row order, the blocks inside them in Z-order
+		};
+
+		constexpr int TraversalBlockSize{ 8 };
+
+		//Offsets of the blocks inside a TraversalBlockSize square, sorted on their Morton code
+		//With 4x2 blocks the square is 2 blocks wide and 4 high, so the Z-order ends up visiting them row by row
+		constexpr std::array<Int2, (TraversalBlockSize / BlockWidth) * (TraversalBlockSize / BlockHeight)> ZOrderOffsets = []
+			{
+				constexpr int nrBlocksX{ TraversalBlockSize / BlockWidth };
+				constexpr int nrBlocksY{ TraversalBlockSize / BlockHeight };
+
+				std::array<Int2, nrBlocksX * nrBlocksY> offsets{};
+				size_t count{};
+				for (uint32_t code{}; count < offsets.size(); ++code)
+				{
+					//De-interleave, even bits are x and odd bits are y
+					int blockX{};
+					int blockY{};
+					for (int bit{}; bit < 8; ++bit)
+					{
+						blockX |= static_cast<int>((code >> (2 * bit)) & 1) << bit;
+						blockY |= static_cast<int>((code >> (2 * bit + 1)) & 1) << bit;
+					}
+
+					if (blockX < nrBlocksX && blockY < nrBlocksY)
+						offsets[count++] = Int2{ blockX * BlockWidth, blockY * BlockHeight };
+				}
+				return offsets;
+			}();
+
+		//Calls visit(x, y) for every block that overlaps the bounding box of the triangle inside the tile
+		//Tiles have to start on the TraversalBlockSize grid
+		template<typename Visitor>
+		void TraverseBlocks(TraversalOrder order, const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax, Visitor&& visit)
+		{
+			//Snapping to the block grid never leaves the tile on the left/top
+			const int minX{ std::max(tileMin.x, triangle.min.x) / BlockWidth * BlockWidth };
+			const int maxX{ std::min(tileMax.x, triangle.max.x) };
+			const int minY{ std::max(tileMin.y, triangle.min.y) / BlockHeight * BlockHeight };
+			const int maxY{ std::min(tileMax.y, triangle.max.y) };
+
+			switch (order)
+			{
+			case TraversalOrder::ColumnMajor:
+				for (int x{ minX }; x <= maxX; x += BlockWidth)
+				{
+					for (int y{ minY }; y <= maxY; y += BlockHeight)
+					{
+						visit(x, y);
+					}
+				}
+				break;
+			case TraversalOrder::RowMajor:
+				for (int y{ minY }; y <= maxY; y += BlockHeight)
+				{
+					for (int x{ minX }; x <= maxX; x += BlockWidth)
+					{
+						visit(x, y);
+					}
+				}
+				break;
+			case TraversalOrder::Blocked:
+				for (int squareY{ minY / TraversalBlockSize * TraversalBlockSize }; squareY <= maxY; squareY += TraversalBlockSize)
+				{
+					for (int squareX{ minX / TraversalBlockSize * TraversalBlockSize }; squareX <= maxX; squareX += TraversalBlockSize)
+					{
+						for (const Int2& offset : ZOrderOffsets)
+						{
+							const int x{ squareX + offset.x };
+							const int y{ squareY + offset.y };
+							if (x < minX || x > maxX || y < minY || y > maxY)
+								continue;
+
+							visit(x, y);
+						}
+					}
+				}
+				break;
+			}
+		}
+
+		//Picks the widest version the CPU (and OS) supports
+		BlockFunction SelectBlockFunction();
+		const char* GetBlockFunctionName(BlockFunction blockFunction);
+	}
+}
@@ -0,0 +1,62 @@
+#include "CpuFeatures.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	namespace CpuFeatures
+	{
+		struct Features
+		{
+			bool hasSSE41{};
+			bool hasAVX2{};
+		};
+
+		static Features Detect()
+		{
+			Features features{};
+
+#ifdef _MSC_VER
+			int info[4]{};
+			__cpuid(info, 0);
+			const int maxLeaf{ info[0] };
+
+			__cpuid(info, 1);
+			features.hasSSE41 = (info[2] & (1 << 19)) != 0;
+
+			//AVX registers also need OS support (OSXSAVE + XMM/YMM state enabled)
+			const bool hasOSAVX{ (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6 };
+			if (maxLeaf >= 7 && hasOSAVX)
+			{
+				__cpuidex(info, 7, 0);
+				features.hasAVX2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			features.hasSSE41 = __builtin_cpu_supports("sse4.1");
+			features.hasAVX2 = __builtin_cpu_supports("avx2");
+#endif
+
+			return features;
+		}
+
+		static const Features& GetFeatures()
+		{
+			static const Features features{ Detect() };
+			return features;
+		}
+
+		bool HasSSE41()
+		{
+			return GetFeatures().hasSSE41;
+		}
+
+		bool HasAVX2()
+		{
+			return GetFeatures().hasAVX2;
+		}
+	}
+}
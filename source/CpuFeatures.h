@@ -0,0 +1,11 @@
+#pragma once
+
+namespace dae
+{
+	//Instruction sets the CPU (and OS) support, detected once
+	namespace CpuFeatures
+	{
+		bool HasSSE41();
+		bool HasAVX2();
+	}
+}
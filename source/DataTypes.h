@@ -1,6 +1,8 @@
 #pragma once
 #include "Math.h"
 #include "vector"
+#include <cstdint>
+#include <memory>
 
 namespace dae
 {
@@ -24,22 +26,277 @@ namespace dae
 		Vector3 viewDirection{};
 	};
 
+	//Triangle counters of the last rendered frame
+	struct RenderStats
+	{
+		uint32_t nrTriangles{};
+		//Completely outside one of the frustum planes
+		uint32_t nrFrustumCulled{};
+		//Crossed the near/far plane or the guard band and went through the clipper
+		uint32_t nrClipped{};
+		//Facing the way the cull mode of their mesh rejects
+		uint32_t nrFaceCulled{};
+		//Meshes skipped before the vertex stage, their triangles count as frustum culled
+		uint32_t nrMeshesCulled{};
+		//Meshlets skipped before the vertex stage, their triangles count as frustum or face culled
+		uint32_t nrMeshletsCulled{};
+		uint32_t nrVertices{};
+		//Vertices that got their attributes transformed, with lazy vertices a vertex counts again on every post-transform cache miss
+		uint32_t nrVerticesTransformed{};
+
+		RenderStats& operator+=(const RenderStats& other)
+		{
+			nrTriangles += other.nrTriangles;
+			nrFrustumCulled += other.nrFrustumCulled;
+			nrClipped += other.nrClipped;
+			nrFaceCulled += other.nrFaceCulled;
+			nrMeshesCulled += other.nrMeshesCulled;
+			nrMeshletsCulled += other.nrMeshletsCulled;
+			nrVertices += other.nrVertices;
+			nrVerticesTransformed += other.nrVerticesTransformed;
+			return *this;
+		}
+	};
+
+	//Value that is affine in screen space, x and y relative to the minimum of the triangle's bounding box
+	struct InterpolationPlane
+	{
+		float origin{};
+		float stepX{};
+		float stepY{};
+
+		inline float Evaluate(float dx, float dy) const
+		{
+			return origin + stepX * dx + stepY * dy;
+		}
+	};
+
+	struct TriangleSetup
+	{
+		//Vertex_Out members that get interpolated, combined as bit flags
+		enum Attribute : uint8_t
+		{
+			UV = 1 << 0,
+			Normal = 1 << 1,
+			Tangent = 1 << 2,
+			ViewDirection = 1 << 3
+		};
+
+		//Pixel bounding box (inclusive), already clamped to the screen
+		Int2 min{};
+		Int2 max{};
+
+		//Vertices are snapped to SubPixelBits fixed point, so the edge functions are exact integers
+		static constexpr int SubPixelBits{ 8 };
+		static constexpr int SubPixelScale{ 1 << SubPixelBits };
+
+		//Edge functions e(x,y) = stepX * x + stepY * y + origin for the edges opposite to v0, v1 and v2, x and y in whole pixels
+		//The top-left fill rule is folded into origin: a pixel is inside when all three are < 0
+		int64_t edgeStepX[3]{};
+		int64_t edgeStepY[3]{};
+		int64_t edgeOrigin[3]{};
+
+		//NDC depth is affine in screen space
+		//Clamped to [minDepth, maxDepth] so rounding can't put it outside the triangle's own range
+		InterpolationPlane depth{};
+		//Nearest and farthest depth the triangle can produce
+		float minDepth{};
+		float maxDepth{};
+
+		//Perspective correct interpolation: attribute / w and 1 / w are affine in screen space, attribute = plane / invW
+		//Only the planes of the attributes that were asked for in setup are filled in
+		InterpolationPlane invW{};
+		InterpolationPlane uv[2]{};
+		InterpolationPlane normal[3]{};
+		InterpolationPlane tangent[3]{};
+		InterpolationPlane viewDirection[3]{};
+
+		inline int64_t GetEdge(int edge, int x, int y) const
+		{
+			return edgeStepX[edge] * x + edgeStepY[edge] * y + edgeOrigin[edge];
+		}
+	};
+
 	enum class PrimitiveTopology
 	{
 		TriangleList,
 		TriangleStrip
 	};
 
+	//Which side of the triangles is skipped, clockwise on screen is the front
+	enum class CullMode
+	{
+		None,
+		Back,
+		Front
+	};
+
+	class MappedFile;
+
+	//Read only vertex or index data of a mesh
+	//Either owns its elements or views memory that something else keeps alive, like the mapped file of a MeshCache
+	template<typename T>
+	class MeshArray final
+	{
+	public:
+		MeshArray() = default;
+		MeshArray(std::vector<T>&& elements)
+			: m_Elements{ std::move(elements) }
+			, m_pData{ m_Elements.data() }
+			, m_Size{ m_Elements.size() }
+		{
+		}
+		MeshArray(const T* pData, size_t size)
+			: m_pData{ pData }
+			, m_Size{ size }
+		{
+		}
+
+		MeshArray(const MeshArray& other)
+			: m_Elements{ other.m_Elements }
+			, m_pData{ other.IsOwning() ? m_Elements.data() : other.m_pData }
+			, m_Size{ other.m_Size }
+		{
+		}
+		//Moving a vector keeps its buffer, so m_pData stays valid
+		MeshArray(MeshArray&& other) noexcept = default;
+		MeshArray& operator=(const MeshArray& other)
+		{
+			if (this != &other)
+			{
+				m_Elements = other.m_Elements;
+				m_pData = other.IsOwning() ? m_Elements.data() : other.m_pData;
+				m_Size = other.m_Size;
+			}
+			return *this;
+		}
+		MeshArray& operator=(MeshArray&& other) noexcept = default;
+
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		const T* data() const { return m_pData; }
+		const T* begin() const { return m_pData; }
+		const T* end() const { return m_pData + m_Size; }
+		const T& operator[](size_t idx) const { return m_pData[idx]; }
+
+	private:
+		std::vector<T> m_Elements{};
+		const T* m_pData{ nullptr };
+		size_t m_Size{};
+
+		bool IsOwning() const { return !m_Elements.empty(); }
+	};
+
+	//Arrays of Mesh::vertexStreams, in order
+	enum class VertexStream
+	{
+		PositionX, PositionY, PositionZ,
+		NormalX, NormalY, NormalZ,
+		TangentX, TangentY, TangentZ,
+		ColorR, ColorG, ColorB,
+		U, V,
+		Count
+	};
+
+	//Cluster of neighbouring triangles that is culled as a whole before the vertex stage, see MeshOptimizer::BuildMeshlets
+	struct Meshlet
+	{
+		static constexpr uint32_t MaxVertices{ 64 };
+		static constexpr uint32_t MaxTriangles{ 124 };
+
+		//Its triangles are a contiguous range of the mesh's triangles
+		uint32_t firstTriangle{};
+		uint32_t nrTriangles{};
+		//Range of Mesh::meshletVertices, every vertex its triangles use once
+		uint32_t firstVertex{};
+		uint32_t nrVertices{};
+
+		//Object space bounding sphere
+		Vector3 center{};
+		float radius{};
+
+		//Object space normal cone, every triangle faces away from a camera at p if Dot((coneApex - p).Normalized(), coneAxis) >= coneCutoff
+		//coneCutoff is above 1 when the normals are spread too far for that to ever happen
+		Vector3 coneApex{};
+		Vector3 coneAxis{};
+		float coneCutoff{};
+	};
+
 	struct Mesh
 	{
-		std::vector<Vertex> vertices{};
-		std::vector<uint32_t> indices{};
+		MeshArray<Vertex> vertices{};
+		MeshArray<uint32_t> indices{};
+		//Structure of arrays copy of what the vertex stage reads, one array per VertexStream of GetVertexStreamStride() floats
+		//The padding at the end of each array is zero, so SIMD loops can read whole groups of 8
+		//Empty if the mesh wasn't loaded through MeshCache, the vertex stage then reads vertices
+		MeshArray<float> vertexStreams{};
+		//Triangles split into meshlets in order, empty if the mesh wasn't loaded through MeshCache
+		MeshArray<Meshlet> meshlets{};
+		MeshArray<uint32_t> meshletVertices{};
+		//Keeps vertices and indices alive when they view a mapped MeshCache file
+		std::shared_ptr<const MappedFile> pMappedFile{};
+		//Object space bounding box and bounding sphere of vertices
+		Vector3 boundsMin{};
+		Vector3 boundsMax{};
+		Vector3 boundsCenter{};
+		float boundsRadius{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
+		CullMode cullMode{ CullMode::Back };
 
 		std::vector<Vertex_Out> vertices_out{};
+		//Clipping::ClipCode bits of every vertex in vertices_out
+		std::vector<uint16_t> clipCodes_out{};
+		//Meshlets that survived culling this frame, and per vertex (padded to GetVertexStreamStride) whether one of them uses it
+		//The vertex stage skips the others, empty means every vertex and every triangle is used
+		std::vector<uint32_t> visibleMeshlets_out{};
+		std::vector<uint8_t> isVertexVisible_out{};
 		Matrix worldMatrix{};
+		//Set by the vertex transformation, used to recalculate the clip space position of vertices that need clipping
+		Matrix worldViewProjection{};
 		bool shouldRotate = true;
 
+		static inline size_t GetVertexStreamStride(size_t nrVertices)
+		{
+			return (nrVertices + 7) / 8 * 8;
+		}
+
+		inline const float* GetVertexStream(VertexStream stream) const
+		{
+			return vertexStreams.data() + static_cast<size_t>(stream) * GetVertexStreamStride(vertices.size());
+		}
+
+		inline size_t GetTriangleCount() const
+		{
+			if (primitiveTopology == PrimitiveTopology::TriangleList)
+				return indices.size() / 3;
+
+			return indices.size() >= 3 ? indices.size() - 2 : 0;
+		}
+
+		inline void GetTriangle(size_t triangleIdx, uint32_t& idx0, uint32_t& idx1, uint32_t& idx2) const
+		{
+			if (primitiveTopology == PrimitiveTopology::TriangleList)
+			{
+				idx0 = indices[triangleIdx * 3];
+				idx1 = indices[triangleIdx * 3 + 1];
+				idx2 = indices[triangleIdx * 3 + 2];
+				return;
+			}
+
+			idx0 = indices[triangleIdx];
+			if (triangleIdx % 2 == 0)
+			{
+				idx1 = indices[triangleIdx + 1];
+				idx2 = indices[triangleIdx + 2];
+			}
+			else
+			{
+				//Fix counterclockwise order
+				idx1 = indices[triangleIdx + 2];
+				idx2 = indices[triangleIdx + 1];
+			}
+		}
+
 		inline void RotateY(float angle, float elapsedSec)
 		{
 			if (!shouldRotate)
@@ -0,0 +1,55 @@
+#include "Frustum.h"
+
+namespace dae
+{
+	//Row vectors, so a clip space coordinate is the dot product with a column
+	static Vector4 GetColumn(const Matrix& matrix, int column)
+	{
+		return Vector4{ matrix[0][column], matrix[1][column], matrix[2][column], matrix[3][column] };
+	}
+
+	static Plane CreatePlane(const Vector4& coefficients)
+	{
+		const Vector3 normal{ coefficients.x, coefficients.y, coefficients.z };
+		const float length{ normal.Magnitude() };
+		return Plane{ normal / length, coefficients.w / length };
+	}
+
+	Frustum Frustum::FromViewProjection(const Matrix& viewProjection)
+	{
+		const Vector4 x{ GetColumn(viewProjection, 0) };
+		const Vector4 y{ GetColumn(viewProjection, 1) };
+		const Vector4 z{ GetColumn(viewProjection, 2) };
+		const Vector4 w{ GetColumn(viewProjection, 3) };
+
+		Frustum frustum{};
+		//0 <= z <= w, -w <= x <= w and -w <= y <= w
+		frustum.planes[Near] = CreatePlane(z);
+		frustum.planes[Far] = CreatePlane(w - z);
+		frustum.planes[Left] = CreatePlane(w + x);
+		frustum.planes[Right] = CreatePlane(w - x);
+		frustum.planes[Bottom] = CreatePlane(w + y);
+		frustum.planes[Top] = CreatePlane(w - y);
+		return frustum;
+	}
+
+	bool Frustum::IsOutside(const Vector3& center, float radius) const
+	{
+		for (const Plane& plane : planes)
+		{
+			if (plane.GetSignedDistance(center) < -radius)
+				return true;
+		}
+		return false;
+	}
+
+	bool Frustum::IsOutside(const Vector3& boundsMin, const Vector3& boundsMax) const
+	{
+		for (const Plane& plane : planes)
+		{
+			if (plane.GetMaxSignedDistance(boundsMin, boundsMax) < 0.f)
+				return true;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Math.h"
+
+namespace dae
+{
+	//Points with Dot(normal, point) + distance >= 0 are on the inside, normal is unit length
+	struct Plane
+	{
+		Vector3 normal{};
+		float distance{};
+
+		float GetSignedDistance(const Vector3& point) const
+		{
+			return Vector3::Dot(normal, point) + distance;
+		}
+
+		//Of the box corner furthest along the normal, below 0 means the whole box is behind the plane
+		float GetMaxSignedDistance(const Vector3& boundsMin, const Vector3& boundsMax) const
+		{
+			return GetSignedDistance(Vector3{
+				normal.x >= 0.f ? boundsMax.x : boundsMin.x,
+				normal.y >= 0.f ? boundsMax.y : boundsMin.y,
+				normal.z >= 0.f ? boundsMax.z : boundsMin.z });
+		}
+
+		//Of the box corner least far along the normal, 0 or more means the whole box is in front of the plane
+		float GetMinSignedDistance(const Vector3& boundsMin, const Vector3& boundsMax) const
+		{
+			return GetSignedDistance(Vector3{
+				normal.x >= 0.f ? boundsMin.x : boundsMax.x,
+				normal.y >= 0.f ? boundsMin.y : boundsMax.y,
+				normal.z >= 0.f ? boundsMin.z : boundsMax.z });
+		}
+	};
+
+	//Six planes bounding what a view projection matrix keeps, in the space the matrix transforms from
+	struct Frustum
+	{
+		//Same planes and order as the Clipping::ClipCode bits, without the guard band
+		enum PlaneIdx
+		{
+			Near, Far, Left, Right, Bottom, Top,
+			NrPlanes
+		};
+
+		Plane planes[NrPlanes]{};
+
+		//Gribb and Hartmann, the clip space planes of Clipping taken back through the matrix
+		static Frustum FromViewProjection(const Matrix& viewProjection);
+
+		//Only true if the volume is completely behind one plane, so it never rejects anything visible
+		//A volume near a corner of the frustum but outside it can still pass
+		bool IsOutside(const Vector3& center, float radius) const;
+		bool IsOutside(const Vector3& boundsMin, const Vector3& boundsMax) const;
+	};
+}
@@ -0,0 +1,387 @@
+#include "Material.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "CpuFeatures.h"
+#include "SamplerAVX2.h"
+
+namespace dae
+{
+	static ColorRGB Lerp(const ColorRGB& a, const ColorRGB& b, float factor)
+	{
+		return ColorRGB::Lerp(a, b, factor);
+	}
+
+	static MaterialSample Lerp(const MaterialSample& a, const MaterialSample& b, float factor)
+	{
+		return MaterialSample
+		{
+			ColorRGB::Lerp(a.diffuse, b.diffuse, factor),
+			ColorRGB::Lerp(a.normal, b.normal, factor),
+			ColorRGB::Lerp(a.specular, b.specular, factor),
+			Lerpf(a.gloss, b.gloss, factor)
+		};
+	}
+
+	Material::Material(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss, bool isBlockCompressed) :
+		m_Width{ diffuse.m_Width },
+		m_Height{ diffuse.m_Height },
+		m_Layout{ isBlockCompressed ? TextureLayout::Linear : diffuse.m_Layout },
+		m_Id{ Texture::GetNextId() }
+	{
+		if (isBlockCompressed)
+			Compress(diffuse, normal, specular, gloss);
+		else
+			Interleave(diffuse, normal, specular, gloss);
+	}
+
+	void Material::Interleave(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss)
+	{
+		size_t nrTexels{};
+		for (const Texture::MipLevel& level : diffuse.m_MipLevels)
+		{
+			nrTexels += diffuse.GetLevelSize(level.width, level.height);
+		}
+
+		//Same layout and size, so index i is the same texel in all four, padding included
+		m_pTexels = new Texel[nrTexels];
+		for (size_t idx{}; idx < nrTexels; ++idx)
+		{
+			m_pTexels[idx].diffuseGloss = (diffuse.m_pTexels[idx] & 0x00FFFFFF) | ((gloss.m_pTexels[idx] & 0xFF) << 24);
+			m_pTexels[idx].normal = normal.m_pTexels[idx];
+			m_pTexels[idx].specular = specular.m_pTexels[idx];
+		}
+
+		for (const Texture::MipLevel& level : diffuse.m_MipLevels)
+		{
+			m_MipLevels.push_back(MipLevel{ m_pTexels + (level.pTexels - diffuse.m_pTexels), level.width, level.height, level.nrTilesX });
+		}
+	}
+
+	void Material::Compress(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss)
+	{
+		size_t nrBlocks{};
+		for (const Texture::MipLevel& level : diffuse.m_MipLevels)
+		{
+			nrBlocks += static_cast<size_t>((level.width + 3) / 4) * ((level.height + 3) / 4);
+		}
+		m_pBlocks = new Block[nrBlocks];
+
+		Block* pBlock{ m_pBlocks };
+		for (size_t levelIdx{}; levelIdx < diffuse.m_MipLevels.size(); ++levelIdx)
+		{
+			const Texture::MipLevel& level{ diffuse.m_MipLevels[levelIdx] };
+			m_MipLevels.push_back(MipLevel{ nullptr, level.width, level.height, (level.width + 3) / 4, pBlock });
+
+			for (int by{}; by < (level.height + 3) / 4; ++by)
+			{
+				for (int bx{}; bx < m_MipLevels.back().nrTilesX; ++bx)
+				{
+					//Blocks past the edge repeat the last row/column, nothing samples those texels
+					uint32_t diffuseGloss[BlockCompression::TexelsPerBlock]{};
+					uint32_t normals[BlockCompression::TexelsPerBlock]{};
+					uint32_t speculars[BlockCompression::TexelsPerBlock]{};
+					for (int idx{}; idx < BlockCompression::TexelsPerBlock; ++idx)
+					{
+						const int x{ std::min(bx * 4 + idx % 4, level.width - 1) };
+						const int y{ std::min(by * 4 + idx / 4, level.height - 1) };
+						const size_t texelIdx{ x + static_cast<size_t>(y) * level.width };
+
+						diffuseGloss[idx] = (level.pTexels[texelIdx] & 0x00FFFFFF) | ((gloss.m_MipLevels[levelIdx].pTexels[texelIdx] & 0xFF) << 24);
+						normals[idx] = normal.m_MipLevels[levelIdx].pTexels[texelIdx];
+						speculars[idx] = specular.m_MipLevels[levelIdx].pTexels[texelIdx];
+					}
+
+					BlockCompression::EncodeBC3(diffuseGloss, pBlock->diffuseGloss);
+					BlockCompression::EncodeBC5(normals, pBlock->normal);
+					BlockCompression::EncodeBC1(speculars, pBlock->specular);
+					++pBlock;
+				}
+			}
+		}
+	}
+
+	Material::~Material()
+	{
+		delete[] m_pTexels;
+		delete[] m_pBlocks;
+	}
+
+	Material* Material::LoadFromFiles(const std::string& diffusePath, const std::string& normalPath, const std::string& specularPath,
+		const std::string& glossPath, TextureLayout layout, bool isBlockCompressed)
+	{
+		//Compression works on the linear texels
+		const TextureLayout textureLayout{ isBlockCompressed ? TextureLayout::Linear : layout };
+		const Texture* pTextures[]
+		{
+			Texture::LoadFromFile(diffusePath, textureLayout),
+			Texture::LoadFromFile(normalPath, textureLayout),
+			Texture::LoadFromFile(specularPath, textureLayout),
+			Texture::LoadFromFile(glossPath, textureLayout)
+		};
+
+		//Same size also means the same layout, Morton only falls back to linear based on the size
+		//The maps are combined texel by texel, so they can't already be block compressed
+		bool isValid{ true };
+		for (const Texture* pTexture : pTextures)
+		{
+			isValid = isValid && pTexture && pTexture->m_Format == TextureFormat::RGBA8
+				&& pTexture->m_Width == pTextures[0]->m_Width && pTexture->m_Height == pTextures[0]->m_Height;
+		}
+
+		Material* pMaterial{ isValid ? new Material{ *pTextures[0], *pTextures[1], *pTextures[2], *pTextures[3], isBlockCompressed } : nullptr };
+
+		for (const Texture* pTexture : pTextures)
+		{
+			delete pTexture;
+		}
+
+		return pMaterial;
+	}
+
+	size_t Material::GetMemorySize() const
+	{
+		if (m_pBlocks)
+		{
+			size_t nrBlocks{};
+			for (const MipLevel& level : m_MipLevels)
+			{
+				nrBlocks += static_cast<size_t>(level.nrTilesX) * ((level.height + 3) / 4);
+			}
+			return nrBlocks * sizeof(Block);
+		}
+
+		//Levels are back to back, so the end of the last one is the size of the allocation
+		const MipLevel& lastLevel{ m_MipLevels.back() };
+		const size_t lastLevelSize{ Texture::GetLevelSize(m_Layout, lastLevel.width, lastLevel.height) };
+		return (lastLevel.pTexels - m_pTexels + lastLevelSize) * sizeof(Texel);
+	}
+
+	Material::Texel Material::FetchBlockTexel(const MipLevel& level, int x, int y) const
+	{
+		//Enough for the 2x2 blocks of a bilinear footprint in two levels
+		thread_local BlockCompression::DecodedBlockCache<Texel, 64> cache{};
+
+		const Block* pBlock{ level.pBlocks + static_cast<size_t>(y >> 2) * level.nrTilesX + (x >> 2) };
+		const uint64_t key{ (m_Id << 40) | static_cast<uint64_t>(pBlock - m_pBlocks) };
+
+		const Texel* pTexels{ cache.Get(key, [pBlock](Texel (&texels)[BlockCompression::TexelsPerBlock])
+			{
+				uint32_t diffuseGloss[BlockCompression::TexelsPerBlock]{};
+				uint32_t normals[BlockCompression::TexelsPerBlock]{};
+				uint32_t speculars[BlockCompression::TexelsPerBlock]{};
+				BlockCompression::DecodeBC3(pBlock->diffuseGloss, diffuseGloss);
+				BlockCompression::DecodeBC5(pBlock->normal, normals);
+				BlockCompression::DecodeBC1(pBlock->specular, speculars);
+
+				for (int idx{}; idx < BlockCompression::TexelsPerBlock; ++idx)
+				{
+					texels[idx] = Texel{ diffuseGloss[idx], normals[idx], speculars[idx] };
+				}
+			}) };
+
+		return pTexels[((y & 3) << 2) + (x & 3)];
+	}
+
+	template<typename Result, typename UnpackFunction>
+	Result Material::Filter(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address, UnpackFunction unpack) const
+	{
+		if (filter == TextureFilter::Nearest)
+			return SampleNearest<Result>(m_MipLevels.front(), uv, address, unpack);
+
+		const float lod{ Texture::GetLod(uvDx, uvDy, m_Width, m_Height, m_MipLevels.size()) };
+
+		switch (filter)
+		{
+		case TextureFilter::NearestMip:
+			return SampleNearest<Result>(m_MipLevels[static_cast<size_t>(lod + 0.5f)], uv, address, unpack);
+		case TextureFilter::Bilinear:
+			return SampleBilinear<Result>(m_MipLevels[static_cast<size_t>(lod + 0.5f)], uv, address, unpack);
+		default:
+		{
+			const size_t level{ static_cast<size_t>(lod) };
+			const float weight{ lod - static_cast<float>(level) };
+
+			const Result result{ SampleBilinear<Result>(m_MipLevels[level], uv, address, unpack) };
+			if (weight == 0.f)
+				return result;
+
+			return Lerp(result, SampleBilinear<Result>(m_MipLevels[level + 1], uv, address, unpack), weight);
+		}
+		}
+	}
+
+	template<typename Result, typename UnpackFunction>
+	Result Material::SampleNearest(const MipLevel& level, const Vector2& uv, TextureAddress address, UnpackFunction unpack) const
+	{
+		const int x{ Texture::ApplyAddress(address, static_cast<int>(std::floor(uv.x * level.width)), level.width) };
+		const int y{ Texture::ApplyAddress(address, static_cast<int>(std::floor(uv.y * level.height)), level.height) };
+
+		return unpack(FetchTexel(level, x, y));
+	}
+
+	template<typename Result, typename UnpackFunction>
+	Result Material::SampleBilinear(const MipLevel& level, const Vector2& uv, TextureAddress address, UnpackFunction unpack) const
+	{
+		//Same footprint and weights as Texture::SampleBilinear
+		const float x{ uv.x * level.width - 0.5f };
+		const float y{ uv.y * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
+		const float weightX{ x - floorX };
+		const float weightY{ y - floorY };
+
+		const int x0{ Texture::ApplyAddress(address, static_cast<int>(floorX), level.width) };
+		const int y0{ Texture::ApplyAddress(address, static_cast<int>(floorY), level.height) };
+		const int x1{ Texture::ApplyAddress(address, static_cast<int>(floorX) + 1, level.width) };
+		const int y1{ Texture::ApplyAddress(address, static_cast<int>(floorY) + 1, level.height) };
+
+		const Result top{ Lerp(unpack(FetchTexel(level, x0, y0)), unpack(FetchTexel(level, x1, y0)), weightX) };
+		const Result bottom{ Lerp(unpack(FetchTexel(level, x0, y1)), unpack(FetchTexel(level, x1, y1)), weightX) };
+		return Lerp(top, bottom, weightY);
+	}
+
+	MaterialSample Material::Sample(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address) const
+	{
+		return Filter<MaterialSample>(uv, uvDx, uvDy, filter, address, [](const Texel& texel)
+			{
+				return MaterialSample
+				{
+					Texture::Unpack(texel.diffuseGloss),
+					Texture::Unpack(texel.normal),
+					Texture::Unpack(texel.specular),
+					Texture::ByteToFloat[texel.diffuseGloss >> 24]
+				};
+			});
+	}
+
+	void Material::SampleBatch(const Vector2* pUVs, const Vector2* pUVDx, const Vector2* pUVDy, int count, TextureFilter filter, TextureAddress address, MaterialSample* pSamples) const
+	{
+		const bool isFiltered{ filter == TextureFilter::Bilinear || filter == TextureFilter::Trilinear };
+		//Block compressed materials decode through the per thread cache one texel at a time
+		if (isFiltered && count > 1 && !m_pBlocks && CpuFeatures::HasAVX2())
+		{
+			float lods[Texture::SampleBatchSize]{};
+			for (int idx{}; idx < count; ++idx)
+			{
+				lods[idx] = Texture::GetLod(pUVDx[idx], pUVDy[idx], m_Width, m_Height, m_MipLevels.size());
+			}
+
+			size_t level{};
+			float weights[Texture::SampleBatchSize]{};
+			if (Texture::GetBatchLevels(lods, count, filter, level, weights))
+			{
+				SampleBatch_AVX2(pUVs, count, level, filter == TextureFilter::Trilinear ? weights : nullptr, address, pSamples);
+				return;
+			}
+		}
+
+		for (int idx{}; idx < count; ++idx)
+		{
+			pSamples[idx] = Sample(pUVs[idx], pUVDx[idx], pUVDy[idx], filter, address);
+		}
+	}
+
+	void Material::SampleBatch_AVX2(const Vector2* pUVs, int count, size_t level, const float* pWeights, TextureAddress address, MaterialSample* pSamples) const
+	{
+		//Diffuse rgb, gloss, normal rgb, specular rgb
+		constexpr int NrChannels{ 10 };
+		static_assert(sizeof(Texel) == 3 * sizeof(uint32_t), "Texels are gathered as three consecutive words");
+
+		//Lanes past count repeat the first uv, their results are dropped
+		alignas(32) float us[Texture::SampleBatchSize]{};
+		alignas(32) float vs[Texture::SampleBatchSize]{};
+		alignas(32) float weights[Texture::SampleBatchSize]{};
+		for (int lane{}; lane < Texture::SampleBatchSize; ++lane)
+		{
+			const int idx{ lane < count ? lane : 0 };
+			us[lane] = pUVs[idx].x;
+			vs[lane] = pUVs[idx].y;
+			weights[lane] = pWeights ? pWeights[idx] : 0.f;
+		}
+
+		const __m256 u{ _mm256_load_ps(us) };
+		const __m256 v{ _mm256_load_ps(vs) };
+
+		const auto sampleLevel{ [&](const MipLevel& mipLevel, __m256 (&channels)[NrChannels])
+			{
+				const SamplerAVX2::Footprint footprint{ SamplerAVX2::GetFootprint(u, v, mipLevel.width, mipLevel.height, mipLevel.nrTilesX, m_Layout, address) };
+				const int* pWords{ reinterpret_cast<const int*>(mipLevel.pTexels) };
+
+				__m256i diffuseGloss[4]{};
+				__m256i normal[4]{};
+				__m256i specular[4]{};
+				for (int corner{}; corner < 4; ++corner)
+				{
+					const __m256i word{ _mm256_mullo_epi32(footprint.texels[corner], _mm256_set1_epi32(3)) };
+					diffuseGloss[corner] = _mm256_i32gather_epi32(pWords, word, 4);
+					normal[corner] = _mm256_i32gather_epi32(pWords + 1, word, 4);
+					specular[corner] = _mm256_i32gather_epi32(pWords + 2, word, 4);
+				}
+
+				channels[0] = SamplerAVX2::FilterChannel<0>(diffuseGloss, footprint);
+				channels[1] = SamplerAVX2::FilterChannel<8>(diffuseGloss, footprint);
+				channels[2] = SamplerAVX2::FilterChannel<16>(diffuseGloss, footprint);
+				channels[3] = SamplerAVX2::FilterChannel<24>(diffuseGloss, footprint);
+				channels[4] = SamplerAVX2::FilterChannel<0>(normal, footprint);
+				channels[5] = SamplerAVX2::FilterChannel<8>(normal, footprint);
+				channels[6] = SamplerAVX2::FilterChannel<16>(normal, footprint);
+				channels[7] = SamplerAVX2::FilterChannel<0>(specular, footprint);
+				channels[8] = SamplerAVX2::FilterChannel<8>(specular, footprint);
+				channels[9] = SamplerAVX2::FilterChannel<16>(specular, footprint);
+			} };
+
+		__m256 channels[NrChannels]{};
+		sampleLevel(m_MipLevels[level], channels);
+
+		//A weight of 0 gives back the first level exactly, like the early out of Sample
+		if (pWeights && level + 1 < m_MipLevels.size())
+		{
+			__m256 nextChannels[NrChannels]{};
+			sampleLevel(m_MipLevels[level + 1], nextChannels);
+
+			const __m256 weight{ _mm256_load_ps(weights) };
+			for (int channel{}; channel < NrChannels; ++channel)
+			{
+				channels[channel] = SamplerAVX2::Lerp(channels[channel], nextChannels[channel], weight);
+			}
+		}
+
+		alignas(32) float results[NrChannels][Texture::SampleBatchSize]{};
+		for (int channel{}; channel < NrChannels; ++channel)
+		{
+			_mm256_store_ps(results[channel], channels[channel]);
+		}
+
+		for (int idx{}; idx < count; ++idx)
+		{
+			pSamples[idx] = MaterialSample
+			{
+				ColorRGB{ results[0][idx], results[1][idx], results[2][idx] },
+				ColorRGB{ results[4][idx], results[5][idx], results[6][idx] },
+				ColorRGB{ results[7][idx], results[8][idx], results[9][idx] },
+				results[3][idx]
+			};
+		}
+	}
+
+	ColorRGB Material::SampleChannel(MaterialChannel channel, const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address) const
+	{
+		switch (channel)
+		{
+		case MaterialChannel::Diffuse:
+			return Filter<ColorRGB>(uv, uvDx, uvDy, filter, address, [](const Texel& texel) { return Texture::Unpack(texel.diffuseGloss); });
+		case MaterialChannel::Normal:
+			return Filter<ColorRGB>(uv, uvDx, uvDy, filter, address, [](const Texel& texel) { return Texture::Unpack(texel.normal); });
+		case MaterialChannel::Specular:
+			return Filter<ColorRGB>(uv, uvDx, uvDy, filter, address, [](const Texel& texel) { return Texture::Unpack(texel.specular); });
+		default:
+			return Filter<ColorRGB>(uv, uvDx, uvDy, filter, address, [](const Texel& texel)
+				{
+					const float gloss{ Texture::ByteToFloat[texel.diffuseGloss >> 24] };
+					return ColorRGB{ gloss, gloss, gloss };
+				});
+		}
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+#include "ColorRGB.h"
+#include "Texture.h"
+#include "Vector2.h"
+
+namespace dae
+{
+	//The maps of a material, for sampling one of them on its own
+	enum class MaterialChannel
+	{
+		Diffuse,
+		Normal,
+		Specular,
+		Gloss //Only the red channel of the map, returned as gray
+	};
+
+	//Everything the shader reads from a material at one uv
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		ColorRGB normal{};
+		ColorRGB specular{};
+		float gloss{};
+	};
+
+	//Diffuse, normal, specular and gloss maps interleaved per texel
+	//One address computation and usually one cache line fetches every shading input, instead of four of each
+	//Block compressed materials interleave per 4x4 block instead, see Block
+	class Material
+	{
+		friend class Benchmark;
+
+	public:
+		~Material();
+
+		Material(const Material&) = delete;
+		Material(Material&&) noexcept = delete;
+		Material& operator=(const Material&) = delete;
+		Material& operator=(Material&&) noexcept = delete;
+
+		//All four maps have to be the same size and decodable by SDL_image, returns nullptr if one fails to load or doesn't match
+		//Block compressed materials ignore layout, their blocks are stored row by row
+		static Material* LoadFromFiles(const std::string& diffusePath, const std::string& normalPath, const std::string& specularPath,
+			const std::string& glossPath, TextureLayout layout = TextureLayout::Linear, bool isBlockCompressed = false);
+
+		//uvDx and uvDy are the screen space derivatives of uv, same filtering and addressing as Texture::Sample
+		MaterialSample Sample(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address = TextureAddress::Clamp) const;
+		//Same result as Sample for count uvs, at most Texture::SampleBatchSize, see Texture::SampleBatch
+		void SampleBatch(const Vector2* pUVs, const Vector2* pUVDx, const Vector2* pUVDy, int count, TextureFilter filter, TextureAddress address, MaterialSample* pSamples) const;
+		//Only unpacks and filters one map, for the debug shading modes
+		ColorRGB SampleChannel(MaterialChannel channel, const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address = TextureAddress::Clamp) const;
+
+		bool IsBlockCompressed() const { return m_pBlocks != nullptr; }
+		//Bytes of texel or block data, the whole mip chain included
+		size_t GetMemorySize() const;
+
+	private:
+		//Gloss only ever uses one channel, it lives in the otherwise unused alpha of diffuse
+		struct Texel
+		{
+			uint32_t diffuseGloss{};
+			uint32_t normal{};
+			uint32_t specular{};
+		};
+
+		//The same 4x4 texels of every map, 40 bytes instead of the 192 of 16 Texels
+		//Gloss rides along in the alpha of BC3 and the normal's z is reconstructed from BC5
+		struct Block
+		{
+			uint8_t diffuseGloss[BlockCompression::BC3BlockBytes]{};
+			uint8_t normal[BlockCompression::BC5BlockBytes]{};
+			uint8_t specular[BlockCompression::BC1BlockBytes]{};
+		};
+
+		struct MipLevel
+		{
+			Texel* pTexels{};
+			int width{};
+			int height{};
+			//Blocks in one row for block compressed materials
+			int nrTilesX{};
+			//Instead of pTexels for block compressed materials
+			const Block* pBlocks{};
+		};
+
+		//The textures have to share size and layout
+		Material(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss, bool isBlockCompressed);
+
+		//All mip levels in one allocation, same order and padding as the source textures
+		Texel* m_pTexels{ nullptr };
+		//Same for block compressed materials, m_pTexels is nullptr then
+		Block* m_pBlocks{ nullptr };
+		int m_Width{};
+		int m_Height{};
+		std::vector<MipLevel> m_MipLevels{};
+		TextureLayout m_Layout{};
+		//Tells the blocks of different materials apart in the per thread decoded block cache
+		uint64_t m_Id{};
+
+		//Copies the mip chains as is, padding included
+		void Interleave(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss);
+		//Encodes every level block by block, the textures have to be linear
+		void Compress(const Texture& diffuse, const Texture& normal, const Texture& specular, const Texture& gloss);
+
+		inline size_t GetTexelIndex(const MipLevel& level, int x, int y) const
+		{
+			return Texture::GetTexelIndex(m_Layout, level.width, level.nrTilesX, x, y);
+		}
+
+		inline Texel FetchTexel(const MipLevel& level, int x, int y) const
+		{
+			if (!m_pBlocks)
+				return level.pTexels[GetTexelIndex(level, x, y)];
+
+			return FetchBlockTexel(level, x, y);
+		}
+
+		//Decodes the 4x4 block holding the texel, or finds it in this thread's cache
+		Texel FetchBlockTexel(const MipLevel& level, int x, int y) const;
+
+		//Filters whatever unpack turns a texel into, Result needs a matching Lerp
+		template<typename Result, typename UnpackFunction>
+		Result Filter(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address, UnpackFunction unpack) const;
+		template<typename Result, typename UnpackFunction>
+		Result SampleNearest(const MipLevel& level, const Vector2& uv, TextureAddress address, UnpackFunction unpack) const;
+		template<typename Result, typename UnpackFunction>
+		Result SampleBilinear(const MipLevel& level, const Vector2& uv, TextureAddress address, UnpackFunction unpack) const;
+		//Bilinear in level, blended towards the next level with pWeights if it isn't nullptr
+		void SampleBatch_AVX2(const Vector2* pUVs, int count, size_t level, const float* pWeights, TextureAddress address, MaterialSample* pSamples) const;
+	};
+}
@@ -0,0 +1,339 @@
+#include "MeshCache.h"
+
+//Standard includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+//Project includes
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+
+namespace dae
+{
+	namespace MeshCache
+	{
+		namespace
+		{
+			//Arrays start on a cache line, which also keeps them aligned in the page aligned mapping
+			constexpr uint64_t ArrayAlignment{ 64 };
+
+			uint64_t AlignUp(uint64_t offset)
+			{
+				return (offset + ArrayAlignment - 1) / ArrayAlignment * ArrayAlignment;
+			}
+
+			uint32_t GetFlags(bool flipAxisAndWinding, bool weldVertices)
+			{
+				return (flipAxisAndWinding ? FlipAxisAndWinding : 0u) | (weldVertices ? WeldVertices : 0u);
+			}
+
+			//FNV-1a 64
+			uint64_t HashFile(const std::string& path)
+			{
+				const MappedFile file{ path };
+				uint64_t hash{ 0xCBF29CE484222325ull };
+				const unsigned char* pData{ reinterpret_cast<const unsigned char*>(file.GetData()) };
+				for (size_t i{}; i < file.GetSize(); ++i)
+				{
+					hash = (hash ^ pData[i]) * 0x100000001B3ull;
+				}
+				return hash;
+			}
+
+			//Same magic, version and layouts as this build writes
+			bool IsCompatible(const Header& header)
+			{
+				return header.magic == Magic && header.version == Version && header.vertexSize == sizeof(Vertex) && header.meshletSize == sizeof(Meshlet) && header.headerSize == sizeof(Header);
+			}
+
+			bool ReadHeader(const std::string& cachePath, Header& header)
+			{
+				std::ifstream file{ cachePath, std::ios::binary };
+				file.read(reinterpret_cast<char*>(&header), sizeof(header));
+				return static_cast<bool>(file);
+			}
+
+			//Box around the vertices, then the sphere around its center through the furthest vertex
+			//Not the smallest sphere, but tighter than the one around the box
+			void GetBounds(const std::vector<Vertex>& vertices, Header& header)
+			{
+				if (vertices.empty())
+				{
+					header.boundsMin = header.boundsMax = header.boundsCenter = Vector3{};
+					header.boundsRadius = 0.f;
+					return;
+				}
+
+				Vector3 boundsMin{ vertices[0].position };
+				Vector3 boundsMax{ vertices[0].position };
+				for (const Vertex& vertex : vertices)
+				{
+					boundsMin = Vector3{ std::min(boundsMin.x, vertex.position.x), std::min(boundsMin.y, vertex.position.y), std::min(boundsMin.z, vertex.position.z) };
+					boundsMax = Vector3{ std::max(boundsMax.x, vertex.position.x), std::max(boundsMax.y, vertex.position.y), std::max(boundsMax.z, vertex.position.z) };
+				}
+
+				const Vector3 center{ (boundsMin + boundsMax) * 0.5f };
+				float sqrRadius{};
+				for (const Vertex& vertex : vertices)
+				{
+					sqrRadius = std::max(sqrRadius, (vertex.position - center).SqrMagnitude());
+				}
+
+				header.boundsMin = boundsMin;
+				header.boundsMax = boundsMax;
+				header.boundsCenter = center;
+				header.boundsRadius = std::sqrt(sqrRadius);
+			}
+
+			void SetBounds(const Header& header, Mesh& mesh)
+			{
+				mesh.boundsMin = header.boundsMin;
+				mesh.boundsMax = header.boundsMax;
+				mesh.boundsCenter = header.boundsCenter;
+				mesh.boundsRadius = header.boundsRadius;
+			}
+
+			//Everything a cache file holds after the header
+			struct MeshData
+			{
+				std::vector<Vertex> vertices{};
+				std::vector<uint32_t> indices{};
+				std::vector<float> vertexStreams{};
+				std::vector<Meshlet> meshlets{};
+				std::vector<uint32_t> meshletVertices{};
+			};
+
+			//Writes to a temporary file first, so a crash or a second instance never leaves a half written cache behind
+			bool WriteCacheFile(const std::string& cachePath, const Header& header, const MeshData& data)
+			{
+				const std::string tempPath{ cachePath + ".tmp" };
+				{
+					std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+					uint64_t position{};
+					//Pads up to offset, which is less than ArrayAlignment away
+					const auto writeArray{ [&](uint64_t offset, const void* pData, uint64_t size)
+						{
+							const char padding[ArrayAlignment]{};
+							file.write(padding, offset - position);
+							file.write(static_cast<const char*>(pData), size);
+							position = offset + size;
+						} };
+					writeArray(0, &header, sizeof(header));
+					writeArray(header.vertexOffset, data.vertices.data(), data.vertices.size() * sizeof(Vertex));
+					writeArray(header.indexOffset, data.indices.data(), data.indices.size() * sizeof(uint32_t));
+					writeArray(header.streamOffset, data.vertexStreams.data(), data.vertexStreams.size() * sizeof(float));
+					writeArray(header.meshletOffset, data.meshlets.data(), data.meshlets.size() * sizeof(Meshlet));
+					writeArray(header.meshletVertexOffset, data.meshletVertices.data(), data.meshletVertices.size() * sizeof(uint32_t));
+					if (!file)
+					{
+						file.close();
+						std::error_code error{};
+						std::filesystem::remove(tempPath, error);
+						return false;
+					}
+				}
+
+				std::error_code error{};
+				std::filesystem::rename(tempPath, cachePath, error);
+				if (error)
+				{
+					std::filesystem::remove(tempPath, error);
+					return false;
+				}
+				return true;
+			}
+
+			//Parses the OBJ and writes its cache file, data keeps everything so the caller can still use it if writing failed
+			bool ParseAndWrite(const std::string& objPath, bool flipAxisAndWinding, bool weldVertices, ThreadPool* pThreadPool, MeshData& data, Header& header, bool& isWritten)
+			{
+				isWritten = false;
+				//The caller may have read an outdated header into it, nothing of that may end up in the new file
+				header = Header{};
+
+				std::error_code error{};
+				header.sourceSize = std::filesystem::file_size(objPath, error);
+				header.sourceWriteTime = std::filesystem::last_write_time(objPath, error).time_since_epoch().count();
+				std::vector<Vertex>& vertices{ data.vertices };
+				std::vector<uint32_t>& indices{ data.indices };
+				if (error || !ObjParser::Parse(objPath, vertices, indices, flipAxisAndWinding, weldVertices, pThreadPool))
+					return false;
+
+				header.acmrSource = MeshOptimizer::GetACMR(indices.data(), indices.size(), vertices.size());
+				MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+				MeshOptimizer::BuildMeshlets(vertices, indices, data.meshlets, data.meshletVertices);
+				header.acmrOptimized = MeshOptimizer::GetACMR(indices.data(), indices.size(), vertices.size());
+
+				header.flags = GetFlags(flipAxisAndWinding, weldVertices);
+				header.contentHash = HashFile(objPath);
+				header.nrVertices = vertices.size();
+				header.nrIndices = indices.size();
+				header.vertexOffset = AlignUp(sizeof(Header));
+				header.indexOffset = AlignUp(header.vertexOffset + vertices.size() * sizeof(Vertex));
+				header.streamOffset = AlignUp(header.indexOffset + indices.size() * sizeof(uint32_t));
+				data.vertexStreams = CreateVertexStreams(vertices.data(), vertices.size());
+				header.nrMeshlets = data.meshlets.size();
+				header.nrMeshletVertices = data.meshletVertices.size();
+				header.meshletOffset = AlignUp(header.streamOffset + data.vertexStreams.size() * sizeof(float));
+				header.meshletVertexOffset = AlignUp(header.meshletOffset + data.meshlets.size() * sizeof(Meshlet));
+				GetBounds(vertices, header);
+
+				isWritten = WriteCacheFile(GetCachePath(objPath), header, data);
+				return true;
+			}
+
+			bool MapCacheFile(const std::string& cachePath, Mesh& mesh, Header& header)
+			{
+				std::shared_ptr<const MappedFile> pFile{ std::make_shared<const MappedFile>(cachePath) };
+				if (!pFile->IsValid() || pFile->GetSize() < sizeof(Header))
+					return false;
+
+				std::memcpy(&header, pFile->GetData(), sizeof(header));
+				const uint64_t size{ pFile->GetSize() };
+				if (!IsCompatible(header)
+					|| header.vertexOffset % alignof(Vertex) != 0 || header.indexOffset % alignof(uint32_t) != 0 || header.streamOffset % alignof(float) != 0
+					|| header.vertexOffset > size || header.nrVertices > (size - header.vertexOffset) / sizeof(Vertex)
+					|| header.indexOffset > size || header.nrIndices > (size - header.indexOffset) / sizeof(uint32_t)
+					|| header.meshletOffset % alignof(Meshlet) != 0 || header.meshletVertexOffset % alignof(uint32_t) != 0
+					|| header.meshletOffset > size || header.nrMeshlets > (size - header.meshletOffset) / sizeof(Meshlet)
+					|| header.meshletVertexOffset > size || header.nrMeshletVertices > (size - header.meshletVertexOffset) / sizeof(uint32_t))
+					return false;
+
+				const size_t nrStreamFloats{ Mesh::GetVertexStreamStride(static_cast<size_t>(header.nrVertices)) * static_cast<size_t>(VertexStream::Count) };
+				if (header.streamOffset > size || nrStreamFloats > (size - header.streamOffset) / sizeof(float))
+					return false;
+
+				mesh.vertices = MeshArray<Vertex>{ reinterpret_cast<const Vertex*>(pFile->GetData() + header.vertexOffset), static_cast<size_t>(header.nrVertices) };
+				mesh.indices = MeshArray<uint32_t>{ reinterpret_cast<const uint32_t*>(pFile->GetData() + header.indexOffset), static_cast<size_t>(header.nrIndices) };
+				mesh.vertexStreams = MeshArray<float>{ reinterpret_cast<const float*>(pFile->GetData() + header.streamOffset), nrStreamFloats };
+				mesh.meshlets = MeshArray<Meshlet>{ reinterpret_cast<const Meshlet*>(pFile->GetData() + header.meshletOffset), static_cast<size_t>(header.nrMeshlets) };
+				mesh.meshletVertices = MeshArray<uint32_t>{ reinterpret_cast<const uint32_t*>(pFile->GetData() + header.meshletVertexOffset), static_cast<size_t>(header.nrMeshletVertices) };
+				mesh.pMappedFile = std::move(pFile);
+				SetBounds(header, mesh);
+				return true;
+			}
+
+			void FillLoadInfo(const Header& header, bool isCached, LoadInfo* pInfo)
+			{
+				if (!pInfo)
+					return;
+
+				pInfo->isCached = isCached;
+				pInfo->nrVertices = static_cast<size_t>(header.nrVertices);
+				pInfo->nrTriangles = static_cast<size_t>(header.nrIndices / 3);
+				pInfo->acmrSource = header.acmrSource;
+				pInfo->acmrOptimized = header.acmrOptimized;
+			}
+		}
+
+		bool Load(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding, bool weldVertices, ThreadPool* pThreadPool, LoadInfo* pInfo)
+		{
+			const std::string cachePath{ GetCachePath(objPath) };
+
+			std::error_code error{};
+			const uint64_t sourceSize{ std::filesystem::file_size(objPath, error) };
+			const int64_t sourceWriteTime{ std::filesystem::last_write_time(objPath, error).time_since_epoch().count() };
+
+			Header header{};
+
+			//A shipped cache file without its OBJ is still usable
+			if (error)
+			{
+				const bool isLoaded{ MapCacheFile(cachePath, mesh, header) };
+				FillLoadInfo(header, true, pInfo);
+				return isLoaded;
+			}
+
+			if (ReadHeader(cachePath, header) && IsCompatible(header)
+				&& header.flags == GetFlags(flipAxisAndWinding, weldVertices) && header.sourceSize == sourceSize)
+			{
+				bool isCurrent{ header.sourceWriteTime == sourceWriteTime };
+				if (!isCurrent && header.contentHash == HashFile(objPath))
+				{
+					//Same content, only touched, remember the new write time so the next launch doesn't hash again
+					std::fstream file{ cachePath, std::ios::binary | std::ios::in | std::ios::out };
+					file.seekp(offsetof(Header, sourceWriteTime));
+					file.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+					isCurrent = true;
+				}
+
+				if (isCurrent && MapCacheFile(cachePath, mesh, header))
+				{
+					FillLoadInfo(header, true, pInfo);
+					return true;
+				}
+			}
+
+			MeshData data{};
+			bool isWritten{};
+			if (!ParseAndWrite(objPath, flipAxisAndWinding, weldVertices, pThreadPool, data, header, isWritten))
+				return false;
+
+			FillLoadInfo(header, false, pInfo);
+
+			//Map what was just written, so the first launch runs on the same memory as every later one
+			Header writtenHeader{};
+			if (isWritten && MapCacheFile(cachePath, mesh, writtenHeader))
+				return true;
+
+			mesh.vertices = MeshArray<Vertex>{ std::move(data.vertices) };
+			mesh.indices = MeshArray<uint32_t>{ std::move(data.indices) };
+			mesh.vertexStreams = MeshArray<float>{ std::move(data.vertexStreams) };
+			mesh.meshlets = MeshArray<Meshlet>{ std::move(data.meshlets) };
+			mesh.meshletVertices = MeshArray<uint32_t>{ std::move(data.meshletVertices) };
+			mesh.pMappedFile.reset();
+			SetBounds(header, mesh);
+			return true;
+		}
+
+		bool LoadCacheFile(const std::string& cachePath, Mesh& mesh)
+		{
+			Header header{};
+			return MapCacheFile(cachePath, mesh, header);
+		}
+
+		bool Build(const std::string& objPath, bool flipAxisAndWinding, bool weldVertices, ThreadPool* pThreadPool)
+		{
+			MeshData data{};
+			Header header{};
+			bool isWritten{};
+			return ParseAndWrite(objPath, flipAxisAndWinding, weldVertices, pThreadPool, data, header, isWritten) && isWritten;
+		}
+
+		std::vector<float> CreateVertexStreams(const Vertex* pVertices, size_t nrVertices)
+		{
+			constexpr size_t nrStreams{ static_cast<size_t>(VertexStream::Count) };
+			const size_t stride{ Mesh::GetVertexStreamStride(nrVertices) };
+			std::vector<float> vertexStreams(stride * nrStreams, 0.f);
+
+			for (size_t i{}; i < nrVertices; ++i)
+			{
+				const Vertex& vertex{ pVertices[i] };
+				//In VertexStream order
+				const float values[nrStreams]{
+					vertex.position.x, vertex.position.y, vertex.position.z,
+					vertex.normal.x, vertex.normal.y, vertex.normal.z,
+					vertex.tangent.x, vertex.tangent.y, vertex.tangent.z,
+					vertex.color.r, vertex.color.g, vertex.color.b,
+					vertex.uv.x, vertex.uv.y };
+
+				for (size_t stream{}; stream < nrStreams; ++stream)
+				{
+					vertexStreams[stream * stride + i] = values[stream];
+				}
+			}
+
+			return vertexStreams;
+		}
+
+		std::string GetCachePath(const std::string& objPath)
+		{
+			return std::filesystem::path{ objPath }.replace_extension(".mesh").string();
+		}
+	}
+}
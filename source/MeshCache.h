@@ -0,0 +1,93 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	class ThreadPool;
+
+	//Binary copy of a parsed OBJ that gets mapped straight into a Mesh instead of parsed again
+	//Its triangles and vertices are already reordered by MeshOptimizer
+	//Stored next to the OBJ as <name>.mesh: a Header, then the Vertex array, the uint32_t index array and Mesh::vertexStreams, all 64 byte aligned
+	namespace MeshCache
+	{
+		constexpr uint32_t Magic{ 0x48534D52 }; //"RMSH"
+		//Bump when Vertex or the processing in ObjParser or MeshOptimizer changes, older cache files get rebuilt
+		constexpr uint32_t Version{ 5 };
+
+		struct Header
+		{
+			uint32_t magic{ Magic };
+			uint32_t version{ Version };
+			//Layout checks, a changed Vertex, Meshlet or Header without a version bump still can't be mapped
+			uint32_t vertexSize{ sizeof(Vertex) };
+			uint32_t meshletSize{ sizeof(Meshlet) };
+			uint32_t headerSize{ sizeof(Header) };
+			//ObjParser::Parse options the data was made with, see Flags
+			uint32_t flags{};
+
+			//The OBJ the data was made from, its size and write time are the quick staleness check
+			//contentHash is FNV-1a over its bytes, checked when only the write time changed (a checkout or a copy)
+			uint64_t sourceSize{};
+			int64_t sourceWriteTime{};
+			uint64_t contentHash{};
+
+			uint64_t nrVertices{};
+			uint64_t nrIndices{};
+			uint64_t vertexOffset{};
+			uint64_t indexOffset{};
+			uint64_t streamOffset{};
+			uint64_t nrMeshlets{};
+			uint64_t nrMeshletVertices{};
+			uint64_t meshletOffset{};
+			uint64_t meshletVertexOffset{};
+
+			Vector3 boundsMin{};
+			Vector3 boundsMax{};
+			Vector3 boundsCenter{};
+			float boundsRadius{};
+
+			//MeshOptimizer::GetACMR of the OBJ's own triangle order and of the stored one
+			float acmrSource{};
+			float acmrOptimized{};
+		};
+
+		//What Load did, for the load log
+		struct LoadInfo
+		{
+			//Mapped an existing cache file instead of parsing the OBJ
+			bool isCached{};
+			size_t nrVertices{};
+			size_t nrTriangles{};
+			float acmrSource{};
+			float acmrOptimized{};
+		};
+
+		enum Flags : uint32_t
+		{
+			FlipAxisAndWinding = 1 << 0,
+			WeldVertices = 1 << 1
+		};
+
+		//Maps the cache file of the OBJ into mesh, its vertices and indices view the mapping afterwards
+		//If there is no valid cache file yet, parses the OBJ with ObjParser::Parse and writes one first
+		//If that can't be written, mesh owns the parsed data instead
+		//Returns false only if the OBJ can't be parsed, fills in pInfo if it isn't nullptr
+		bool Load(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding = true, bool weldVertices = true, ThreadPool* pThreadPool = nullptr,
+			LoadInfo* pInfo = nullptr);
+
+		//Maps an existing cache file into mesh, without looking at the OBJ
+		//Returns false if it is missing, from another version or truncated
+		bool LoadCacheFile(const std::string& cachePath, Mesh& mesh);
+
+		//Parses the OBJ and writes its cache file, whether or not there already is one
+		bool Build(const std::string& objPath, bool flipAxisAndWinding = true, bool weldVertices = true, ThreadPool* pThreadPool = nullptr);
+
+		//Mesh::vertexStreams of these vertices
+		std::vector<float> CreateVertexStreams(const Vertex* pVertices, size_t nrVertices);
+
+		//<name>.mesh next to <name>.obj
+		std::string GetCachePath(const std::string& objPath);
+	}
+}
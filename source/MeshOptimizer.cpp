@@ -0,0 +1,539 @@
+#include "MeshOptimizer.h"
+
+//Standard includes
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	namespace MeshOptimizer
+	{
+		namespace
+		{
+			constexpr int CacheSize{ 32 };
+			//Scores of valences above this are all the same, high valence vertices are rare
+			constexpr int MaxValence{ 32 };
+
+			constexpr float CacheDecayPower{ 1.5f };
+			//The vertices of the last triangle get a fixed score, so the next one doesn't just reuse the same edge and make a strip
+			constexpr float LastTriangleScore{ 0.75f };
+			constexpr float ValenceBoostScale{ 2.f };
+			constexpr float ValenceBoostPower{ 0.5f };
+
+			//Scores indexed by cache position (+1, so -1 is outside the cache) and by the nr of triangles left, precomputed once
+			struct ScoreTables
+			{
+				float cache[CacheSize + 1]{};
+				float valence[MaxValence + 1]{};
+
+				ScoreTables()
+				{
+					for (int position{}; position < CacheSize; ++position)
+					{
+						if (position < 3)
+						{
+							cache[position + 1] = LastTriangleScore;
+						}
+						else
+						{
+							const float scale{ 1.f / (CacheSize - 3) };
+							cache[position + 1] = std::pow(1.f - (position - 3) * scale, CacheDecayPower);
+						}
+					}
+
+					for (int nrTriangles{ 1 }; nrTriangles <= MaxValence; ++nrTriangles)
+					{
+						valence[nrTriangles] = ValenceBoostScale * std::pow(static_cast<float>(nrTriangles), -ValenceBoostPower);
+					}
+				}
+			};
+
+			float GetVertexScore(const ScoreTables& tables, int cachePosition, uint32_t nrTrianglesLeft)
+			{
+				//Nothing left to draw with it
+				if (nrTrianglesLeft == 0)
+					return -1.f;
+
+				return tables.cache[cachePosition + 1] + tables.valence[std::min(nrTrianglesLeft, static_cast<uint32_t>(MaxValence))];
+			}
+
+			//Unit front normal of every triangle, zero for degenerate ones, they are never drawn so they can face any way
+			//Clockwise triangles face the camera, so the front normal is Cross(p1 - p0, p2 - p0) in this left handed space
+			std::vector<Vector3> GetTriangleNormals(const std::vector<Vertex>& vertices, const uint32_t* pIndices, size_t nrTriangles)
+			{
+				std::vector<Vector3> normals(nrTriangles);
+				for (size_t triangle{}; triangle < nrTriangles; ++triangle)
+				{
+					const Vector3& p0{ vertices[pIndices[triangle * 3]].position };
+					const Vector3& p1{ vertices[pIndices[triangle * 3 + 1]].position };
+					const Vector3& p2{ vertices[pIndices[triangle * 3 + 2]].position };
+					const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+					const float length{ normal.Magnitude() };
+					if (length > 0.f)
+						normals[triangle] = normal / length;
+				}
+				return normals;
+			}
+
+			//Index of the first vertex at the exact same position, for every vertex
+			//Vertices split on a uv or normal seam are still neighbours for grouping triangles
+			std::vector<uint32_t> GetFirstAtPosition(const std::vector<Vertex>& vertices)
+			{
+				using Key = std::array<uint32_t, 3>;
+				struct KeyHash
+				{
+					size_t operator()(const Key& key) const
+					{
+						return ((key[0] * 0x9E3779B97F4A7C15ull) ^ key[1]) * 0x9E3779B97F4A7C15ull ^ key[2];
+					}
+				};
+
+				std::unordered_map<Key, uint32_t, KeyHash> firstIndices{};
+				firstIndices.reserve(vertices.size());
+
+				std::vector<uint32_t> firstAtPosition(vertices.size());
+				for (size_t idx{}; idx < vertices.size(); ++idx)
+				{
+					Key key{};
+					std::memcpy(key.data(), &vertices[idx].position, sizeof(Key));
+					firstAtPosition[idx] = firstIndices.try_emplace(key, static_cast<uint32_t>(idx)).first->second;
+				}
+				return firstAtPosition;
+			}
+
+			//Grows meshlets one triangle at a time, starting from the first triangle left in the current order
+			//Of the triangles touching the meshlet it takes the one that adds the fewest vertices and bends its normal cone the least
+			//Triangles facing too far from the meshlet's average normal don't join, a wide cone is never culled
+			//When none fits, the next triangle in the current order still joins if it faces the same way, small parts don't each get a meshlet
+			//Returns the indices with every meshlet's triangles after each other, nrMeshletTriangles gets the size of each
+			std::vector<uint32_t> GroupMeshletTriangles(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<uint32_t>& nrMeshletTriangles)
+			{
+				//A new vertex costs as much as this much 1 - cos of the angle to the average normal
+				constexpr float ConeWeight{ 4.f };
+				//Cos of the largest angle to the average normal a triangle can have, about 53 degrees, and one that doesn't touch the meshlet
+				constexpr float MinNormalDot{ 0.6f };
+				constexpr float MinUnconnectedDot{ 0.8f };
+
+				const size_t nrTriangles{ indices.size() / 3 };
+				const size_t nrVertices{ vertices.size() };
+				const std::vector<Vector3> normals{ GetTriangleNormals(vertices, indices.data(), nrTriangles) };
+				const std::vector<uint32_t> firstAtPosition{ GetFirstAtPosition(vertices) };
+
+				//Triangles around every position, compressed as one array with an offset per first vertex at that position
+				std::vector<uint32_t> triangleOffsets(nrVertices + 1, 0);
+				for (const uint32_t index : indices)
+				{
+					++triangleOffsets[firstAtPosition[index] + 1];
+				}
+				for (size_t vertex{}; vertex < nrVertices; ++vertex)
+				{
+					triangleOffsets[vertex + 1] += triangleOffsets[vertex];
+				}
+				std::vector<uint32_t> positionTriangles(indices.size());
+				{
+					std::vector<uint32_t> nrAdded(nrVertices, 0);
+					for (size_t i{}; i < indices.size(); ++i)
+					{
+						const uint32_t position{ firstAtPosition[indices[i]] };
+						positionTriangles[triangleOffsets[position] + nrAdded[position]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+
+				std::vector<uint32_t> grouped{};
+				grouped.reserve(indices.size());
+				std::vector<bool> isEmitted(nrTriangles, false);
+
+				//Meshlet a vertex or a position was last added to
+				constexpr uint32_t NoMeshlet{ UINT32_MAX };
+				std::vector<uint32_t> vertexAddedTo(nrVertices, NoMeshlet);
+				std::vector<uint32_t> positionAddedTo(nrVertices, NoMeshlet);
+				uint32_t currentMeshlet{};
+				uint32_t meshletVertices{};
+				std::vector<uint32_t> meshletPositions{};
+				uint32_t meshletTriangles{};
+				Vector3 normalSum{};
+
+				const auto getNrNewVertices{ [&](size_t triangle)
+					{
+						const uint32_t* pTriangle{ &indices[triangle * 3] };
+						uint32_t nrNew{};
+						for (int corner{}; corner < 3; ++corner)
+						{
+							if (vertexAddedTo[pTriangle[corner]] != currentMeshlet && (corner < 1 || pTriangle[corner] != pTriangle[0]) && (corner < 2 || pTriangle[corner] != pTriangle[1]))
+								++nrNew;
+						}
+						return nrNew;
+					} };
+
+				size_t nextUnemitted{};
+				for (size_t nrEmitted{}; nrEmitted < nrTriangles; ++nrEmitted)
+				{
+					while (isEmitted[nextUnemitted])
+					{
+						++nextUnemitted;
+					}
+
+					const float normalLength{ normalSum.Magnitude() };
+					const Vector3 axis{ normalLength > 0.f ? normalSum / normalLength : Vector3{} };
+					const auto getSpread{ [&](size_t triangle)
+						{
+							return normals[triangle].SqrMagnitude() > 0.f ? 1.f - Vector3::Dot(normals[triangle], axis) : 0.f;
+						} };
+
+					int64_t bestTriangle{ -1 };
+					if (meshletTriangles < Meshlet::MaxTriangles)
+					{
+						float bestScore{ FLT_MAX };
+						for (const uint32_t position : meshletPositions)
+						{
+							for (uint32_t i{ triangleOffsets[position] }; i < triangleOffsets[position + 1]; ++i)
+							{
+								const uint32_t triangle{ positionTriangles[i] };
+								if (isEmitted[triangle])
+									continue;
+
+								const uint32_t nrNew{ getNrNewVertices(triangle) };
+								const float spread{ getSpread(triangle) };
+								if (meshletVertices + nrNew > Meshlet::MaxVertices || 1.f - spread < MinNormalDot)
+									continue;
+
+								const float score{ nrNew + ConeWeight * spread };
+								if (score < bestScore)
+								{
+									bestScore = score;
+									bestTriangle = triangle;
+								}
+							}
+						}
+
+						if (bestTriangle < 0 && meshletTriangles > 0 && meshletVertices + getNrNewVertices(nextUnemitted) <= Meshlet::MaxVertices
+							&& 1.f - getSpread(nextUnemitted) >= MinUnconnectedDot)
+							bestTriangle = static_cast<int64_t>(nextUnemitted);
+					}
+
+					//Start the next meshlet from where the vertex cache order is
+					if (bestTriangle < 0)
+					{
+						if (meshletTriangles > 0)
+						{
+							nrMeshletTriangles.push_back(meshletTriangles);
+							++currentMeshlet;
+							meshletVertices = 0;
+							meshletPositions.clear();
+							meshletTriangles = 0;
+							normalSum = Vector3{};
+						}
+						bestTriangle = static_cast<int64_t>(nextUnemitted);
+					}
+
+					const size_t triangle{ static_cast<size_t>(bestTriangle) };
+					isEmitted[triangle] = true;
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const uint32_t vertex{ indices[triangle * 3 + corner] };
+						grouped.push_back(vertex);
+						if (vertexAddedTo[vertex] != currentMeshlet)
+						{
+							vertexAddedTo[vertex] = currentMeshlet;
+							++meshletVertices;
+						}
+
+						const uint32_t position{ firstAtPosition[vertex] };
+						if (positionAddedTo[position] != currentMeshlet)
+						{
+							positionAddedTo[position] = currentMeshlet;
+							meshletPositions.push_back(position);
+						}
+					}
+					normalSum += normals[triangle];
+					++meshletTriangles;
+				}
+
+				if (meshletTriangles > 0)
+					nrMeshletTriangles.push_back(meshletTriangles);
+
+				return grouped;
+			}
+
+			//Sphere around the center of the box around the vertices, through the furthest one
+			void SetMeshletSphere(const std::vector<Vertex>& vertices, const uint32_t* pVertices, Meshlet& meshlet)
+			{
+				Vector3 boundsMin{ vertices[pVertices[0]].position };
+				Vector3 boundsMax{ boundsMin };
+				for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+				{
+					const Vector3& position{ vertices[pVertices[i]].position };
+					boundsMin = Vector3{ std::min(boundsMin.x, position.x), std::min(boundsMin.y, position.y), std::min(boundsMin.z, position.z) };
+					boundsMax = Vector3{ std::max(boundsMax.x, position.x), std::max(boundsMax.y, position.y), std::max(boundsMax.z, position.z) };
+				}
+
+				meshlet.center = (boundsMin + boundsMax) * 0.5f;
+				float sqrRadius{};
+				for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+				{
+					sqrRadius = std::max(sqrRadius, (vertices[pVertices[i]].position - meshlet.center).SqrMagnitude());
+				}
+				meshlet.radius = std::sqrt(sqrRadius);
+			}
+
+			//Axis is the average of the triangle normals, the apex is moved back along it until it is behind every triangle
+			//A camera inside the cone around -axis through the apex, narrowed by the spread of the normals, is behind all of them
+			void SetMeshletCone(const std::vector<Vertex>& vertices, const uint32_t* pIndices, Meshlet& meshlet)
+			{
+				const std::vector<Vector3> normals{ GetTriangleNormals(vertices, pIndices, meshlet.nrTriangles) };
+				Vector3 axis{};
+				for (const Vector3& normal : normals)
+				{
+					axis += normal;
+				}
+
+				meshlet.coneApex = meshlet.center;
+				meshlet.coneCutoff = 2.f;
+				const float axisLength{ axis.Magnitude() };
+				if (axisLength <= 0.f)
+					return;
+				meshlet.coneAxis = axis / axisLength;
+
+				float minDot{ 1.f };
+				for (const Vector3& normal : normals)
+				{
+					if (normal.SqrMagnitude() > 0.f)
+						minDot = std::min(minDot, Vector3::Dot(normal, meshlet.coneAxis));
+				}
+				//Normals more than 90 degrees apart, some triangle faces every camera position
+				if (minDot <= 0.f)
+					return;
+
+				float maxDistance{};
+				for (uint32_t triangle{}; triangle < meshlet.nrTriangles; ++triangle)
+				{
+					const Vector3& normal{ normals[triangle] };
+					if (normal.SqrMagnitude() <= 0.f)
+						continue;
+
+					const Vector3& p0{ vertices[pIndices[triangle * 3]].position };
+					maxDistance = std::max(maxDistance, Vector3::Dot(meshlet.center - p0, normal) / Vector3::Dot(meshlet.coneAxis, normal));
+				}
+
+				meshlet.coneApex = meshlet.center - meshlet.coneAxis * maxDistance;
+				meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+			}
+		}
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices)
+		{
+			static const ScoreTables tables{};
+
+			const size_t nrTriangles{ indices.size() / 3 };
+			if (nrTriangles == 0 || nrVertices == 0)
+				return;
+
+			//Triangles of every vertex, compressed as one array with an offset per vertex
+			std::vector<uint32_t> nrTrianglesLeft(nrVertices, 0);
+			for (size_t i{}; i < nrTriangles * 3; ++i)
+			{
+				++nrTrianglesLeft[indices[i]];
+			}
+
+			std::vector<uint32_t> triangleOffsets(nrVertices + 1, 0);
+			for (size_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				triangleOffsets[vertex + 1] = triangleOffsets[vertex] + nrTrianglesLeft[vertex];
+			}
+
+			//Each vertex keeps its triangles that are left at the front of its range, so emitting one is a swap with the last
+			std::vector<uint32_t> vertexTriangles(triangleOffsets[nrVertices]);
+			{
+				std::vector<uint32_t> nrAdded(nrVertices, 0);
+				for (size_t triangle{}; triangle < nrTriangles; ++triangle)
+				{
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const uint32_t vertex{ indices[triangle * 3 + corner] };
+						vertexTriangles[triangleOffsets[vertex] + nrAdded[vertex]++] = static_cast<uint32_t>(triangle);
+					}
+				}
+			}
+
+			std::vector<int> cachePositions(nrVertices, -1);
+			std::vector<float> vertexScores(nrVertices);
+			for (size_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				vertexScores[vertex] = GetVertexScore(tables, -1, nrTrianglesLeft[vertex]);
+			}
+
+			std::vector<float> triangleScores(nrTriangles);
+			std::vector<bool> isEmitted(nrTriangles, false);
+			for (size_t triangle{}; triangle < nrTriangles; ++triangle)
+			{
+				triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+			}
+
+			//The emitted triangle's vertices go in front, so up to 3 entries fall off the end
+			uint32_t cache[CacheSize + 3]{};
+			int cacheCount{};
+
+			std::vector<uint32_t> optimized{};
+			optimized.reserve(nrTriangles * 3);
+
+			//Searching every triangle is quadratic, so only ones touching the cache are candidates
+			//When none of those is left, continue with the next triangle in the original order
+			size_t nextUnemitted{};
+			int64_t bestTriangle{ -1 };
+
+			for (size_t nrEmitted{}; nrEmitted < nrTriangles; ++nrEmitted)
+			{
+				if (bestTriangle < 0)
+				{
+					while (isEmitted[nextUnemitted])
+					{
+						++nextUnemitted;
+					}
+					bestTriangle = static_cast<int64_t>(nextUnemitted);
+				}
+
+				const size_t triangle{ static_cast<size_t>(bestTriangle) };
+				const uint32_t* pTriangle{ &indices[triangle * 3] };
+				optimized.insert(optimized.end(), pTriangle, pTriangle + 3);
+				isEmitted[triangle] = true;
+
+				//Remove the triangle from its vertices
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertex{ pTriangle[corner] };
+					uint32_t* pBegin{ &vertexTriangles[triangleOffsets[vertex]] };
+					uint32_t* pEnd{ pBegin + nrTrianglesLeft[vertex] };
+					*std::find(pBegin, pEnd, static_cast<uint32_t>(triangle)) = *(pEnd - 1);
+					--nrTrianglesLeft[vertex];
+				}
+
+				//Move its vertices to the front of the cache, keeping the order of the rest
+				uint32_t newCache[CacheSize + 3]{};
+				int newCount{};
+				for (int corner{}; corner < 3; ++corner)
+				{
+					newCache[newCount++] = pTriangle[corner];
+				}
+				for (int i{}; i < cacheCount; ++i)
+				{
+					const uint32_t vertex{ cache[i] };
+					if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+						newCache[newCount++] = vertex;
+				}
+
+				//Rescore the cached vertices and the triangles around them, pick the best of those next
+				bestTriangle = -1;
+				float bestScore{ -1.f };
+				for (int i{}; i < newCount; ++i)
+				{
+					const uint32_t vertex{ newCache[i] };
+					cachePositions[vertex] = i < CacheSize ? i : -1;
+					const float score{ GetVertexScore(tables, cachePositions[vertex], nrTrianglesLeft[vertex]) };
+					const float scoreChange{ score - vertexScores[vertex] };
+					vertexScores[vertex] = score;
+
+					const uint32_t* pBegin{ &vertexTriangles[triangleOffsets[vertex]] };
+					for (const uint32_t* pTriangleIdx{ pBegin }; pTriangleIdx != pBegin + nrTrianglesLeft[vertex]; ++pTriangleIdx)
+					{
+						float& triangleScore{ triangleScores[*pTriangleIdx] };
+						triangleScore += scoreChange;
+						if (triangleScore > bestScore)
+						{
+							bestScore = triangleScore;
+							bestTriangle = *pTriangleIdx;
+						}
+					}
+				}
+
+				cacheCount = std::min(newCount, CacheSize);
+				std::copy(newCache, newCache + cacheCount, cache);
+			}
+
+			indices = std::move(optimized);
+		}
+
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			constexpr uint32_t Unused{ UINT32_MAX };
+			std::vector<uint32_t> remap(vertices.size(), Unused);
+			std::vector<Vertex> reordered{};
+			reordered.reserve(vertices.size());
+
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == Unused)
+				{
+					remap[index] = static_cast<uint32_t>(reordered.size());
+					reordered.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+
+			vertices = std::move(reordered);
+		}
+
+		void BuildMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices)
+		{
+			meshlets.clear();
+			meshletVertices.clear();
+
+			std::vector<uint32_t> nrMeshletTriangles{};
+			indices = GroupMeshletTriangles(vertices, indices, nrMeshletTriangles);
+			OptimizeVertexFetch(vertices, indices);
+
+			//Meshlet a vertex was last added to, so each one is only added once per meshlet
+			constexpr uint32_t NoMeshlet{ UINT32_MAX };
+			std::vector<uint32_t> addedTo(vertices.size(), NoMeshlet);
+
+			uint32_t firstTriangle{};
+			for (const uint32_t nrTriangles : nrMeshletTriangles)
+			{
+				Meshlet meshlet{};
+				meshlet.firstTriangle = firstTriangle;
+				meshlet.nrTriangles = nrTriangles;
+				meshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+				for (uint32_t i{ firstTriangle * 3 }; i < (firstTriangle + nrTriangles) * 3; ++i)
+				{
+					if (addedTo[indices[i]] == meshlets.size())
+						continue;
+
+					addedTo[indices[i]] = static_cast<uint32_t>(meshlets.size());
+					meshletVertices.push_back(indices[i]);
+					++meshlet.nrVertices;
+				}
+
+				SetMeshletSphere(vertices, &meshletVertices[meshlet.firstVertex], meshlet);
+				SetMeshletCone(vertices, &indices[meshlet.firstTriangle * 3], meshlet);
+				meshlets.push_back(meshlet);
+				firstTriangle += nrTriangles;
+			}
+		}
+
+		float GetACMR(const uint32_t* pIndices, size_t nrIndices, size_t nrVertices, int cacheSize)
+		{
+			const size_t nrTriangles{ nrIndices / 3 };
+			if (nrTriangles == 0)
+				return 0.f;
+
+			//A vertex is cached if it went in less than cacheSize misses ago
+			std::vector<int64_t> insertedAt(nrVertices, INT64_MIN / 2);
+			int64_t nrMisses{};
+			for (size_t i{}; i < nrTriangles * 3; ++i)
+			{
+				int64_t& timestamp{ insertedAt[pIndices[i]] };
+				if (nrMisses - timestamp > cacheSize)
+				{
+					timestamp = nrMisses;
+					++nrMisses;
+				}
+			}
+
+			return static_cast<float>(nrMisses) / nrTriangles;
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Reorders triangle list meshes for the post-transform vertex cache and for vertex fetches and splits them into meshlets
+	//Done once before a MeshCache file is written
+	namespace MeshOptimizer
+	{
+		//Entries of the FIFO cache GetACMR simulates, the size of the classic hardware post-transform cache
+		constexpr int SimulatedCacheSize{ 16 };
+
+		//Reorders the triangles so ones that share vertices are close together (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+		//Scores against a 32 entry LRU cache, which also does well on smaller FIFO caches
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices);
+
+		//Reorders the vertices in the order the indices first use them, so they are read and written almost sequentially
+		//Vertices no index uses are dropped
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		//Groups the triangles into meshlets of at most Meshlet::MaxVertices vertices and Meshlet::MaxTriangles triangles that face about the same way
+		//Reorders the triangles so every meshlet is a contiguous range, then the vertices like OptimizeVertexFetch
+		//Run it after OptimizeVertexCache, each meshlet starts where that order is and keeps most of its locality
+		//Fills in the bounding sphere and the normal cone of every meshlet, the cone only rejects back facing triangles (clockwise is front)
+		void BuildMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices);
+
+		//Average cache miss ratio: vertices transformed per triangle with a FIFO cache of cacheSize entries
+		//0.5 is the best a large regular grid can do, 3 means no vertex is ever reused
+		float GetACMR(const uint32_t* pIndices, size_t nrIndices, size_t nrVertices, int cacheSize = SimulatedCacheSize);
+	}
+}
@@ -0,0 +1,459 @@
+#include "ObjParser.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace ObjParser
+	{
+		//Bytes per parse job, small enough to spread a few MB over every thread
+		constexpr size_t ChunkSize{ 128 * 1024 };
+		constexpr uint32_t NoIndex{ UINT32_MAX };
+
+		//0 based indices into the merged attribute arrays, NoIndex if the corner doesn't have that attribute
+		struct FaceCorner
+		{
+			uint32_t position{ NoIndex };
+			uint32_t uv{ NoIndex };
+			uint32_t normal{ NoIndex };
+
+			bool operator==(const FaceCorner& other) const = default;
+		};
+
+		struct FaceCornerHash
+		{
+			size_t operator()(const FaceCorner& corner) const
+			{
+				return (corner.position * 73856093u) ^ (corner.uv * 19349663u) ^ (corner.normal * 83492791u);
+			}
+		};
+
+		//Everything one job reads from its lines, merged in file order afterwards
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+			std::vector<Vector3> positions{};
+			std::vector<Vector2> uvs{};
+			std::vector<Vector3> normals{};
+			//3 per triangle, polygons are already split
+			std::vector<FaceCorner> corners{};
+			//Vertex the first triangle of the chunk creates
+			size_t firstVertex{};
+			bool isValid{ true };
+		};
+
+		static bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		static const char* SkipSpaces(const char* p, const char* pEnd)
+		{
+			while (p < pEnd && IsSpace(*p))
+			{
+				++p;
+			}
+			return p;
+		}
+
+		//Returns nullptr if there is no number, from_chars is locale independent and rounds like operator>>
+		static const char* ParseFloat(const char* p, const char* pEnd, float& value)
+		{
+			p = SkipSpaces(p, pEnd);
+			if (p < pEnd && *p == '+')
+				++p;
+
+			const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+			return error == std::errc{} ? pNext : nullptr;
+		}
+
+		//OBJ indices start at 1
+		static const char* ParseIndex(const char* p, const char* pEnd, uint32_t& index)
+		{
+			uint32_t value{};
+			const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+			if (error != std::errc{} || value == 0)
+				return nullptr;
+
+			index = value - 1;
+			return pNext;
+		}
+
+		//"position", "position/uv", "position//normal" or "position/uv/normal"
+		static const char* ParseCorner(const char* p, const char* pEnd, FaceCorner& corner)
+		{
+			p = ParseIndex(p, pEnd, corner.position);
+			if (!p || p == pEnd || *p != '/')
+				return p;
+
+			++p;
+			if (p < pEnd && *p != '/')
+			{
+				p = ParseIndex(p, pEnd, corner.uv);
+				if (!p)
+					return nullptr;
+			}
+
+			if (p < pEnd && *p == '/')
+				p = ParseIndex(p + 1, pEnd, corner.normal);
+
+			return p;
+		}
+
+		//Returns false on a malformed line, unknown commands are skipped
+		static bool ParseLine(Chunk& chunk, const char* p, const char* pEnd, std::vector<FaceCorner>& polygon)
+		{
+			const char* pCommandEnd{ p };
+			while (pCommandEnd < pEnd && !IsSpace(*pCommandEnd))
+			{
+				++pCommandEnd;
+			}
+			const std::string_view command{ p, static_cast<size_t>(pCommandEnd - p) };
+			p = pCommandEnd;
+
+			if (command == "v" || command == "vn")
+			{
+				Vector3 vector{};
+				if (!(p = ParseFloat(p, pEnd, vector.x)) || !(p = ParseFloat(p, pEnd, vector.y)) || !(p = ParseFloat(p, pEnd, vector.z)))
+					return false;
+
+				(command == "v" ? chunk.positions : chunk.normals).push_back(vector);
+			}
+			else if (command == "vt")
+			{
+				Vector2 uv{};
+				if (!(p = ParseFloat(p, pEnd, uv.x)) || !(p = ParseFloat(p, pEnd, uv.y)))
+					return false;
+
+				chunk.uvs.emplace_back(uv.x, 1 - uv.y);
+			}
+			else if (command == "f")
+			{
+				polygon.clear();
+				for (p = SkipSpaces(p, pEnd); p < pEnd; p = SkipSpaces(p, pEnd))
+				{
+					FaceCorner corner{};
+					if (!(p = ParseCorner(p, pEnd, corner)))
+						return false;
+
+					polygon.push_back(corner);
+				}
+
+				if (polygon.size() < 3)
+					return false;
+
+				for (size_t cornerIdx{ 1 }; cornerIdx + 1 < polygon.size(); ++cornerIdx)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[cornerIdx]);
+					chunk.corners.push_back(polygon[cornerIdx + 1]);
+				}
+			}
+
+			return true;
+		}
+
+		static void ParseChunk(Chunk& chunk)
+		{
+			std::vector<FaceCorner> polygon{};
+
+			for (const char* p{ chunk.pBegin }; p < chunk.pEnd && chunk.isValid; )
+			{
+				const char* pLineEnd{ static_cast<const char*>(std::memchr(p, '\n', chunk.pEnd - p)) };
+				if (!pLineEnd)
+					pLineEnd = chunk.pEnd;
+
+				chunk.isValid = ParseLine(chunk, SkipSpaces(p, pLineEnd), pLineEnd, polygon);
+				p = pLineEnd + 1;
+			}
+		}
+
+		//Same math and order as Utils::ParseOBJ
+		static Vector3 GetTangent(const Vertex* pVertices, uint32_t index0, uint32_t index1, uint32_t index2)
+		{
+			const Vector3& p0 = pVertices[index0].position;
+			const Vector3& p1 = pVertices[index1].position;
+			const Vector3& p2 = pVertices[index2].position;
+			const Vector2& uv0 = pVertices[index0].uv;
+			const Vector2& uv1 = pVertices[index1].uv;
+			const Vector2& uv2 = pVertices[index2].uv;
+
+			const Vector3 edge0 = p1 - p0;
+			const Vector3 edge1 = p2 - p0;
+			const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
+			const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
+			float r = 1.f / Vector2::Cross(diffX, diffY);
+
+			return (edge0 * diffY.y - edge1 * diffY.x) * r;
+		}
+
+		//Turns the summed tangent into a unit vector orthogonal to the normal and flips z if needed
+		static void FinishVertex(Vertex& vertex, bool flipAxisAndWinding)
+		{
+			vertex.tangent = Vector3::Reject(vertex.tangent, vertex.normal).Normalized();
+
+			if (flipAxisAndWinding)
+			{
+				vertex.position.z *= -1.f;
+				vertex.normal.z *= -1.f;
+				vertex.tangent.z *= -1.f;
+			}
+		}
+
+		static bool IsCornerValid(const FaceCorner& corner, const std::vector<Vector3>& positions, const std::vector<Vector2>& uvs, const std::vector<Vector3>& normals)
+		{
+			return corner.position < positions.size()
+				&& (corner.uv == NoIndex || corner.uv < uvs.size())
+				&& (corner.normal == NoIndex || corner.normal < normals.size());
+		}
+
+		static Vertex MakeVertex(const FaceCorner& corner, const std::vector<Vector3>& positions, const std::vector<Vector2>& uvs, const std::vector<Vector3>& normals)
+		{
+			Vertex vertex{};
+			vertex.position = positions[corner.position];
+			if (corner.uv != NoIndex)
+				vertex.uv = uvs[corner.uv];
+			if (corner.normal != NoIndex)
+				vertex.normal = normals[corner.normal];
+
+			return vertex;
+		}
+
+		//Index of the first attribute with the exact same bits, for every attribute
+		//Exporters often repeat a value, like a face normal for each of its corners
+		template<typename Attribute>
+		static std::vector<uint32_t> GetFirstOccurrences(const std::vector<Attribute>& attributes)
+		{
+			using Key = std::array<uint32_t, sizeof(Attribute) / sizeof(uint32_t)>;
+			struct KeyHash
+			{
+				size_t operator()(const Key& key) const
+				{
+					size_t hash{};
+					for (const uint32_t word : key)
+					{
+						hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+					}
+					return hash;
+				}
+			};
+
+			std::unordered_map<Key, uint32_t, KeyHash> firstIndices{};
+			firstIndices.reserve(attributes.size());
+
+			std::vector<uint32_t> firstOccurrences(attributes.size());
+			for (size_t idx{}; idx < attributes.size(); ++idx)
+			{
+				Key key{};
+				std::memcpy(key.data(), &attributes[idx], sizeof(Key));
+				firstOccurrences[idx] = firstIndices.try_emplace(key, static_cast<uint32_t>(idx)).first->second;
+			}
+
+			return firstOccurrences;
+		}
+
+		//Corners with the same position, uv and normal become one vertex, attributes are compared by value
+		//Tangents are summed over every triangle sharing the vertex, so FinishVertex averages their directions
+		static bool WeldVertices(const std::vector<Chunk>& chunks, const std::vector<Vector3>& positions, const std::vector<Vector2>& uvs, const std::vector<Vector3>& normals,
+			bool flipAxisAndWinding, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			size_t nrCorners{};
+			for (const Chunk& chunk : chunks)
+			{
+				nrCorners += chunk.corners.size();
+			}
+
+			const std::vector<uint32_t> firstPositions{ GetFirstOccurrences(positions) };
+			const std::vector<uint32_t> firstUVs{ GetFirstOccurrences(uvs) };
+			const std::vector<uint32_t> firstNormals{ GetFirstOccurrences(normals) };
+
+			std::unordered_map<FaceCorner, uint32_t, FaceCornerHash> vertexIndices{};
+			vertexIndices.reserve(nrCorners);
+			indices.reserve(nrCorners);
+
+			for (const Chunk& chunk : chunks)
+			{
+				for (size_t cornerIdx{}; cornerIdx < chunk.corners.size(); cornerIdx += 3)
+				{
+					uint32_t triangle[3]{};
+					for (size_t idx{}; idx < 3; ++idx)
+					{
+						const FaceCorner& corner{ chunk.corners[cornerIdx + idx] };
+						if (!IsCornerValid(corner, positions, uvs, normals))
+							return false;
+
+						const FaceCorner key
+						{
+							firstPositions[corner.position],
+							corner.uv == NoIndex ? NoIndex : firstUVs[corner.uv],
+							corner.normal == NoIndex ? NoIndex : firstNormals[corner.normal]
+						};
+
+						const auto [it, isNew] { vertexIndices.try_emplace(key, static_cast<uint32_t>(vertices.size())) };
+						if (isNew)
+							vertices.push_back(MakeVertex(corner, positions, uvs, normals));
+
+						triangle[idx] = it->second;
+					}
+
+					indices.push_back(triangle[0]);
+					indices.push_back(flipAxisAndWinding ? triangle[2] : triangle[1]);
+					indices.push_back(flipAxisAndWinding ? triangle[1] : triangle[2]);
+				}
+			}
+
+			for (size_t idx{}; idx < indices.size(); idx += 3)
+			{
+				const Vector3 tangent{ GetTangent(vertices.data(), indices[idx], indices[idx + 1], indices[idx + 2]) };
+
+				//Degenerate uvs give an infinite tangent, which would now spread to the neighbours sharing the vertex
+				if (!std::isfinite(tangent.x) || !std::isfinite(tangent.y) || !std::isfinite(tangent.z))
+					continue;
+
+				vertices[indices[idx]].tangent += tangent;
+				vertices[indices[idx + 1]].tangent += tangent;
+				vertices[indices[idx + 2]].tangent += tangent;
+			}
+
+			for (Vertex& vertex : vertices)
+			{
+				FinishVertex(vertex, flipAxisAndWinding);
+			}
+
+			return true;
+		}
+
+		bool Parse(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding, bool weldVertices,
+			ThreadPool* pThreadPool)
+		{
+			vertices.clear();
+			indices.clear();
+
+			const MappedFile file{ filename };
+			if (!file.IsValid())
+				return false;
+
+			//Chunks end right after a newline, so no line is split over two jobs
+			std::vector<Chunk> chunks{};
+			const char* pFileEnd{ file.GetData() + file.GetSize() };
+			for (const char* pBegin{ file.GetData() }; pBegin < pFileEnd; pBegin = chunks.back().pEnd)
+			{
+				const char* pEnd{ pFileEnd };
+				if (static_cast<size_t>(pFileEnd - pBegin) > ChunkSize)
+				{
+					const char* pNewline{ static_cast<const char*>(std::memchr(pBegin + ChunkSize, '\n', pFileEnd - pBegin - ChunkSize)) };
+					pEnd = pNewline ? pNewline + 1 : pFileEnd;
+				}
+
+				chunks.emplace_back();
+				chunks.back().pBegin = pBegin;
+				chunks.back().pEnd = pEnd;
+			}
+
+			const auto parallelFor{ [pThreadPool](size_t jobCount, const std::function<void(uint32_t, uint32_t)>& job)
+				{
+					if (pThreadPool)
+					{
+						pThreadPool->ParallelFor(static_cast<uint32_t>(jobCount), job);
+						return;
+					}
+
+					for (uint32_t jobIdx{}; jobIdx < jobCount; ++jobIdx)
+					{
+						job(jobIdx, 0);
+					}
+				} };
+
+			parallelFor(chunks.size(), [&chunks](uint32_t chunkIdx, uint32_t) { ParseChunk(chunks[chunkIdx]); });
+
+			//Attributes are merged in file order, the absolute face indices point into the merged arrays
+			std::vector<Vector3> positions{};
+			std::vector<Vector2> uvs{};
+			std::vector<Vector3> normals{};
+			size_t nrVertices{};
+			for (Chunk& chunk : chunks)
+			{
+				if (!chunk.isValid)
+					return false;
+
+				positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+				uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+				normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+				chunk.firstVertex = nrVertices;
+				nrVertices += chunk.corners.size();
+			}
+
+			if (nrVertices > UINT32_MAX)
+				return false;
+
+			if (weldVertices)
+			{
+				if (WeldVertices(chunks, positions, uvs, normals, flipAxisAndWinding, vertices, indices))
+					return true;
+
+				vertices.clear();
+				indices.clear();
+				return false;
+			}
+
+			vertices.resize(nrVertices);
+			indices.resize(nrVertices);
+
+			//Without welding every chunk fills its own range of vertices and indices
+			parallelFor(chunks.size(), [&](uint32_t chunkIdx, uint32_t)
+				{
+					Chunk& chunk{ chunks[chunkIdx] };
+					for (size_t cornerIdx{}; cornerIdx < chunk.corners.size(); cornerIdx += 3)
+					{
+						const uint32_t first{ static_cast<uint32_t>(chunk.firstVertex + cornerIdx) };
+						for (uint32_t idx{}; idx < 3; ++idx)
+						{
+							const FaceCorner& corner{ chunk.corners[cornerIdx + idx] };
+							if (!IsCornerValid(corner, positions, uvs, normals))
+							{
+								chunk.isValid = false;
+								return;
+							}
+
+							vertices[first + idx] = MakeVertex(corner, positions, uvs, normals);
+						}
+
+						indices[first] = first;
+						indices[first + 1] = flipAxisAndWinding ? first + 2 : first + 1;
+						indices[first + 2] = flipAxisAndWinding ? first + 1 : first + 2;
+
+						//Every vertex belongs to exactly this triangle, so nothing is shared between jobs
+						const Vector3 tangent{ GetTangent(vertices.data(), indices[first], indices[first + 1], indices[first + 2]) };
+						for (uint32_t idx{}; idx < 3; ++idx)
+						{
+							vertices[first + idx].tangent += tangent;
+							FinishVertex(vertices[first + idx], flipAxisAndWinding);
+						}
+					}
+				});
+
+			for (const Chunk& chunk : chunks)
+			{
+				if (!chunk.isValid)
+				{
+					vertices.clear();
+					indices.clear();
+					return false;
+				}
+			}
+
+			return true;
+		}
+	}
+}
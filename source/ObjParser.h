@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	class ThreadPool;
+
+	//Drop-in replacement for Utils::ParseOBJ that maps the file and parses line aligned chunks of it in parallel
+	namespace ObjParser
+	{
+		//Triangle list with tangents, z and winding flipped if flipAxisAndWinding
+		//weldVertices shares one vertex between all face corners with the same position, uv and normal and averages its tangent over them
+		//Without it the output is exactly that of Utils::ParseOBJ, 3 unshared vertices per triangle
+		//Polygons are split into a fan, relative (negative) indices aren't supported
+		//Returns false if the file can't be read or a face references a missing position, uv or normal
+		//Runs on the calling thread only if pThreadPool is nullptr
+		bool Parse(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true,
+			bool weldVertices = true, ThreadPool* pThreadPool = nullptr);
+	}
+}
@@ -2,12 +2,24 @@
 #include "SDL.h"
 #include "SDL_surface.h"
 
+//Standard includes
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
 //Project includes
 #include "Renderer.h"
+#include "Clipping.h"
+#include "CpuFeatures.h"
 #include "Math.h"
 #include "Matrix.h"
+#include "MeshCache.h"
 #include "Texture.h"
+#include "ThreadPool.h"
 #include "Utils.h"
+#include "VertexStageAVX2.h"
 
 using namespace dae;
 
@@ -29,26 +41,38 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	//Initialize depthBuffer
 	m_pDepthBufferPixels = new float[m_Width * m_Height] {INFINITY};
 
+	//Initialize HiZ
+	m_NrHiZCellsX = (m_Width + HiZCellSize - 1) / HiZCellSize;
+	m_NrHiZCellsY = (m_Height + HiZCellSize - 1) / HiZCellSize;
+	m_pHiZCells = new HiZCell[m_NrHiZCellsX * m_NrHiZCellsY]{};
+
+	//Initialize tiled rasterization
+	m_pThreadPool = new ThreadPool{};
+	m_NrTilesX = (m_Width + TileSize - 1) / TileSize;
+	m_NrTilesY = (m_Height + TileSize - 1) / TileSize;
+	m_BinChunks.resize(m_pThreadPool->GetThreadCount());
+	m_TestBlock = Coverage::SelectBlockFunction();
+
 	//Load in textures
 	m_pTextureGrid = Texture::LoadFromFile("Resources/uv_grid_2.png");
 	m_pTuktukTexture = Texture::LoadFromFile("Resources/tuktuk.png");
-	m_pVehicleDiffuse = Texture::LoadFromFile("Resources/vehicle_diffuse.png");
-	m_pVehicleNormal = Texture::LoadFromFile("Resources/vehicle_normal.png");
-	m_pVehicleGloss = Texture::LoadFromFile("Resources/vehicle_gloss.png");
-	m_pVehicleSpecular = Texture::LoadFromFile("Resources/vehicle_specular.png");
+	LoadVehicleMaterial(TextureLayout::Linear);
 
 
 	m_MeshesWorld.emplace_back(Mesh{});
 	m_MeshesWorld.emplace_back(Mesh{});
 
-	Utils::ParseOBJ("Resources/tuktuk.obj", m_MeshesWorld[0].vertices, m_MeshesWorld[0].indices);
-	m_MeshesWorld[0].primitiveTopology = PrimitiveTopology::TriangleList;
-	m_MeshesWorld[0].vertices_out.reserve(m_MeshesWorld[0].vertices.size());
-
+	const char* meshPaths[]{ "Resources/tuktuk.obj", "Resources/vehicle.obj" };
+	for (size_t mesh = 0; mesh < m_MeshesWorld.size(); mesh++)
+	{
+		MeshCache::LoadInfo info{};
+		MeshCache::Load(meshPaths[mesh], m_MeshesWorld[mesh], true, true, m_pThreadPool, &info);
+		m_MeshesWorld[mesh].primitiveTopology = PrimitiveTopology::TriangleList;
+		m_MeshesWorld[mesh].vertices_out.reserve(m_MeshesWorld[mesh].vertices.size());
 
-	Utils::ParseOBJ("Resources/vehicle.obj", m_MeshesWorld[1].vertices, m_MeshesWorld[1].indices);
-	m_MeshesWorld[1].primitiveTopology = PrimitiveTopology::TriangleList;
-	m_MeshesWorld[1].vertices_out.reserve(m_MeshesWorld[1].vertices.size());
+		std::cout << "Loaded " << meshPaths[mesh] << (info.isCached ? " from its cache file" : " and wrote its cache file") << ", " << info.nrVertices << " vertices, "
+			<< info.nrTriangles << " triangles, " << m_MeshesWorld[mesh].meshlets.size() << " meshlets, ACMR " << info.acmrSource << " -> " << info.acmrOptimized << std::endl;
+	}
 
 	for (size_t mesh = 0; mesh < m_MeshesWorld.size(); mesh++)
 	{
@@ -56,18 +80,28 @@ Renderer::Renderer(SDL_Window* pWindow) :
 		{
 			m_MeshesWorld[mesh].vertices_out.emplace_back(Vertex_Out{});
 		}
+		m_MeshesWorld[mesh].clipCodes_out.resize(m_MeshesWorld[mesh].vertices_out.size());
 	}
+
+	BuildSceneBVH();
 }
 
 Renderer::~Renderer()
 {
+	delete m_pThreadPool;
 	delete[] m_pDepthBufferPixels;
+	delete[] m_pHiZCells;
 	delete m_pTextureGrid;
 	delete m_pTuktukTexture;
-	delete m_pVehicleDiffuse;
-	delete m_pVehicleNormal;
-	delete m_pVehicleGloss;
-	delete m_pVehicleSpecular;
+	delete m_pVehicleMaterial;
+}
+
+void Renderer::LoadVehicleMaterial(TextureLayout layout, bool isBlockCompressed)
+{
+	delete m_pVehicleMaterial;
+
+	m_pVehicleMaterial = Material::LoadFromFiles("Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png",
+		"Resources/vehicle_specular.png", "Resources/vehicle_gloss.png", layout, isBlockCompressed);
 }
 
 void Renderer::Update(Timer* pTimer)
@@ -77,6 +111,10 @@ void Renderer::Update(Timer* pTimer)
 	const float yawAngle = 50.f;
 
 	m_MeshesWorld[1].RotateY(yawAngle, pTimer->GetElapsed());
+	if (m_MeshesWorld[1].shouldRotate)
+	{
+		OnMeshMoved(1);
+	}
 
 }
 
@@ -171,14 +209,65 @@ void Renderer::Render_Week2()
 	//Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
 
-	const int pixelCount{ m_Width * m_Height };
-	std::fill_n(m_pDepthBufferPixels, pixelCount, INFINITY);
-	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
-	
+	//Everything that depends on the shading mode is picked once per draw
+	m_InterpolatedAttributes = GetInterpolatedAttributes(m_CurrentShadingMode, m_UseNormalMap);
+	m_pLoopOverPixels = SelectLoopOverPixels();
+
+	//Meshes completely outside the view frustum skip the vertex stage and binning, so do meshlets outside it or facing away
+	//The scene BVH only visits the meshes near the frustum, its boxes are refit around the meshes that moved first
+	const Frustum frustum{ m_Camera.GetFrustum() };
+	m_SceneBVH.Refit();
+	m_SceneBVH.Cull(frustum, m_VisibleMeshes);
+	//Same draw order every frame, whatever order the tree has them in
+	std::sort(m_VisibleMeshes.begin(), m_VisibleMeshes.end());
+
+	//Everything the tree culled, the visible meshes are taken back out below
+	RenderStats culledStats{};
+	culledStats.nrMeshesCulled = static_cast<uint32_t>(m_SceneMeshes.size() - m_VisibleMeshes.size());
+	culledStats.nrTriangles = m_NrSceneTriangles;
+	culledStats.nrFrustumCulled = m_NrSceneTriangles;
+	culledStats.nrVertices = m_NrSceneVertices;
+
+	std::vector<const Mesh*> visibleMeshes{};
+	for (const uint32_t meshIdx : m_VisibleMeshes)
+	{
+		Mesh* pMesh{ &m_MeshesWorld[meshIdx] };
+		culledStats.nrTriangles -= static_cast<uint32_t>(pMesh->GetTriangleCount());
+		culledStats.nrFrustumCulled -= static_cast<uint32_t>(pMesh->GetTriangleCount());
+		culledStats.nrVertices -= static_cast<uint32_t>(pMesh->vertices.size());
 
-	VertexTransformationFunction(m_MeshesWorld[1]);
-	RenderTriangleList(m_MeshesWorld[1]);
-	
+		//The tree already tested the box, the sphere can still be outside when the box isn't
+		if (IsSphereOutsideFrustum(*pMesh, frustum))
+		{
+			++culledStats.nrMeshesCulled;
+			culledStats.nrTriangles += static_cast<uint32_t>(pMesh->GetTriangleCount());
+			culledStats.nrFrustumCulled += static_cast<uint32_t>(pMesh->GetTriangleCount());
+			culledStats.nrVertices += static_cast<uint32_t>(pMesh->vertices.size());
+			continue;
+		}
+
+		if (m_UseMeshletCulling && !pMesh->meshlets.empty())
+		{
+			CullMeshlets(*pMesh, frustum, culledStats);
+			if (pMesh->visibleMeshlets_out.empty())
+			{
+				culledStats.nrVertices += static_cast<uint32_t>(pMesh->vertices.size());
+				continue;
+			}
+		}
+		else
+		{
+			pMesh->isVertexVisible_out.clear();
+		}
+
+		VertexTransformationFunction(*pMesh, m_UseLazyVertices);
+		visibleMeshes.push_back(pMesh);
+	}
+	BinTriangles(visibleMeshes);
+	m_Stats += culledStats;
+
+	//Clearing the buffers happens per tile
+	RasterizeTiles();
 
 	
 	//@END
@@ -234,6 +323,57 @@ void dae::Renderer::ToggleNormalMap()
 	m_UseNormalMap = !m_UseNormalMap;
 }
 
+void dae::Renderer::ToggleTextureFilter()
+{
+	switch (m_TextureFilter)
+	{
+	case TextureFilter::Nearest:
+		m_TextureFilter = TextureFilter::NearestMip;
+		break;
+	case TextureFilter::NearestMip:
+		m_TextureFilter = TextureFilter::Bilinear;
+		break;
+	case TextureFilter::Bilinear:
+		m_TextureFilter = TextureFilter::Trilinear;
+		break;
+	case TextureFilter::Trilinear:
+		m_TextureFilter = TextureFilter::Nearest;
+		break;
+	}
+}
+
+void dae::Renderer::ToggleTextureAddress()
+{
+	switch (m_TextureAddress)
+	{
+	case TextureAddress::Wrap:
+		m_TextureAddress = TextureAddress::Clamp;
+		break;
+	case TextureAddress::Clamp:
+		m_TextureAddress = TextureAddress::Mirror;
+		break;
+	case TextureAddress::Mirror:
+		m_TextureAddress = TextureAddress::Wrap;
+		break;
+	}
+}
+
+void dae::Renderer::ToggleBlockCompression()
+{
+	m_UseBlockCompression = !m_UseBlockCompression;
+	LoadVehicleMaterial(TextureLayout::Linear, m_UseBlockCompression);
+}
+
+void dae::Renderer::ToggleLazyVertices()
+{
+	m_UseLazyVertices = !m_UseLazyVertices;
+}
+
+void dae::Renderer::ToggleMeshletCulling()
+{
+	m_UseMeshletCulling = !m_UseMeshletCulling;
+}
+
 void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const
 {
 	float aspectRatio{ static_cast<float>(m_Width) / m_Height };
@@ -258,225 +398,870 @@ void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_
 	}
 }
 
-void Renderer::VertexTransformationFunction( Mesh& mesh) const
+void Renderer::VertexTransformationFunction( Mesh& mesh, bool positionsOnly) const
+{
+	mesh.worldViewProjection = mesh.worldMatrix * m_Camera.invViewMatrix * m_Camera.projectionMatrix;
+
+	const bool useAVX2{ !mesh.vertexStreams.empty() && CpuFeatures::HasAVX2() };
+	const size_t nrVertices{ mesh.vertices.size() };
+	const uint32_t nrJobs{ static_cast<uint32_t>((nrVertices + VerticesPerJob - 1) / VerticesPerJob) };
+
+	//Every job gets its own range, a multiple of 8 so only the last one has vertices left for the scalar loop
+	m_pThreadPool->ParallelFor(nrJobs, [&](uint32_t jobIdx, uint32_t)
+		{
+			const size_t begin{ static_cast<size_t>(jobIdx) * VerticesPerJob };
+			const size_t end{ std::min(begin + VerticesPerJob, nrVertices) };
+			if (mesh.isVertexVisible_out.empty())
+			{
+				TransformVertexRange(mesh, positionsOnly, useAVX2, begin, end);
+				return;
+			}
+
+			//Runs of groups of 8 with at least one visible vertex, the padding makes reading a whole group safe
+			const auto isGroupVisible{ [&](size_t groupBegin)
+				{
+					uint64_t isVisible{};
+					std::memcpy(&isVisible, &mesh.isVertexVisible_out[groupBegin], sizeof(isVisible));
+					return isVisible != 0;
+				} };
+
+			size_t runBegin{ begin };
+			while (runBegin < end)
+			{
+				while (runBegin < end && !isGroupVisible(runBegin))
+				{
+					runBegin += 8;
+				}
+
+				size_t runEnd{ runBegin };
+				while (runEnd < end && isGroupVisible(runEnd))
+				{
+					runEnd += 8;
+				}
+
+				runEnd = std::min(runEnd, end);
+				if (runBegin < runEnd)
+					TransformVertexRange(mesh, positionsOnly, useAVX2, runBegin, runEnd);
+				runBegin = runEnd;
+			}
+		});
+
+}
+
+void Renderer::TransformVertexRange(Mesh& mesh, bool positionsOnly, bool useAVX2, size_t begin, size_t end) const
 {
-	const float aspectRatio{ static_cast<float>(m_Width) / m_Height };
-	const Matrix worldViewProjection{ mesh.worldMatrix * m_Camera.invViewMatrix * m_Camera.projectionMatrix };
+	const float width{ static_cast<float>(m_Width) };
+	const float height{ static_cast<float>(m_Height) };
+
+	size_t i{ begin };
+	if (useAVX2 && positionsOnly)
+		i = VertexStageAVX2::TransformPositions(mesh, width, height, begin, end, mesh.vertices_out.data(), mesh.clipCodes_out.data());
+	else if (useAVX2)
+		i = VertexStageAVX2::TransformVertices(mesh, m_Camera.origin, width, height, begin, end, mesh.vertices_out.data(), mesh.clipCodes_out.data());
 
-	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	for (; i < end; i++)
 	{
-		mesh.vertices_out[i].color = mesh.vertices[i].color;
-		mesh.vertices_out[i].position.x = mesh.vertices[i].position.x;
-		mesh.vertices_out[i].position.y = mesh.vertices[i].position.y;
-		mesh.vertices_out[i].position.z = mesh.vertices[i].position.z;
-		mesh.vertices_out[i].uv = mesh.vertices[i].uv;
-		mesh.vertices_out[i].normal = mesh.worldMatrix.TransformVector(mesh.vertices[i].normal).Normalized();
-		mesh.vertices_out[i].tangent = mesh.worldMatrix.TransformVector(mesh.vertices[i].tangent).Normalized();
-		mesh.vertices_out[i].viewDirection = mesh.worldMatrix.TransformPoint(mesh.vertices[i].position) - m_Camera.origin;
+		if (!positionsOnly)
+			TransformVertexAttributes(mesh, i, mesh.vertices_out[i]);
+		TransformVertexPosition(mesh, i);
+	}
+}
 
+void Renderer::TransformVertexPosition(Mesh& mesh, size_t vertexIdx) const
+{
+	Vector4& position{ mesh.vertices_out[vertexIdx].position };
+	position = mesh.worldViewProjection.TransformPoint(Vector4{ mesh.vertices[vertexIdx].position, 1.f });
+	mesh.clipCodes_out[vertexIdx] = Clipping::GetClipCode(position);
 
-		mesh.vertices_out[i].position = worldViewProjection.TransformPoint(mesh.vertices_out[i].position);
 
+	//Perspective Divide, the result is only used when the triangles of this vertex don't need clipping
+	const float invW{ 1.f / position.w };
 
-		//Perspective Divide
-		const float invW{ 1.f / mesh.vertices_out[i].position.w };
+	position.x *= invW;
+	position.y *= invW;
+	position.z *= invW;
+
+
+	position.x = (position.x + 1) / 2 * m_Width;
+	position.y = (1 - position.y) / 2 * m_Height;
+}
+
+void Renderer::TransformVertexAttributes(const Mesh& mesh, size_t vertexIdx, Vertex_Out& vertex) const
+{
+	const Vertex& vertexIn{ mesh.vertices[vertexIdx] };
+	vertex.color = vertexIn.color;
+	vertex.uv = vertexIn.uv;
+	vertex.normal = mesh.worldMatrix.TransformVector(vertexIn.normal).Normalized();
+	vertex.tangent = mesh.worldMatrix.TransformVector(vertexIn.tangent).Normalized();
+	vertex.viewDirection = mesh.worldMatrix.TransformPoint(vertexIn.position) - m_Camera.origin;
+}
 
-		mesh.vertices_out[i].position.x *= invW;	
-		mesh.vertices_out[i].position.y *= invW;	
-		mesh.vertices_out[i].position.z *= invW;	
+Vertex_Out Renderer::FetchVertex(BinChunk& chunk, const Mesh& mesh, uint32_t vertexIdx) const
+{
+	VertexCache& cache{ chunk.vertexCache };
+	const uint32_t slot{ vertexIdx & (VertexCache::Size - 1) };
+	Vertex_Out& vertex{ cache.vertices[slot] };
+
+	if (cache.vertexIndices[slot] != vertexIdx)
+	{
+		cache.vertexIndices[slot] = vertexIdx;
+		vertex.position = mesh.vertices_out[vertexIdx].position;
+		TransformVertexAttributes(mesh, vertexIdx, vertex);
+		++chunk.stats.nrVerticesTransformed;
+	}
+
+	//A copy, the other vertices of the triangle can evict this slot
+	return vertex;
+}
 
+void Renderer::BuildSceneBVH()
+{
+	std::vector<SceneBVH::Item> items{};
+	items.reserve(m_SceneMeshes.size());
+	m_NrSceneTriangles = 0;
+	m_NrSceneVertices = 0;
+	for (const uint32_t meshIdx : m_SceneMeshes)
+	{
+		const Mesh& mesh{ m_MeshesWorld[meshIdx] };
+		SceneBVH::Item item{};
+		item.id = meshIdx;
+		GetWorldBounds(mesh, item.boundsMin, item.boundsMax);
+		items.push_back(item);
+
+		m_NrSceneTriangles += static_cast<uint32_t>(mesh.GetTriangleCount());
+		m_NrSceneVertices += static_cast<uint32_t>(mesh.vertices.size());
+	}
+	m_SceneBVH.Build(items);
+}
 
-		mesh.vertices_out[i].position.x = (mesh.vertices_out[i].position.x + 1) / 2 * m_Width;
-		mesh.vertices_out[i].position.y = (1 - mesh.vertices_out[i].position.y) / 2 * m_Height;
+void Renderer::OnMeshMoved(uint32_t meshIdx)
+{
+	Vector3 boundsMin{};
+	Vector3 boundsMax{};
+	GetWorldBounds(m_MeshesWorld[meshIdx], boundsMin, boundsMax);
+	m_SceneBVH.SetBounds(meshIdx, boundsMin, boundsMax);
+}
 
+void Renderer::GetWorldBounds(const Mesh& mesh, Vector3& boundsMin, Vector3& boundsMax)
+{
+	//Every axis of the box adds the absolute value of its transformed half size to the world space half size
+	const Matrix& world{ mesh.worldMatrix };
+	const Vector3 center{ world.TransformPoint((mesh.boundsMin + mesh.boundsMax) * 0.5f) };
+	const Vector3 halfSize{ (mesh.boundsMax - mesh.boundsMin) * 0.5f };
+	Vector3 worldHalfSize{};
+	for (int axis{}; axis < 3; ++axis)
+	{
+		const Vector4 row{ world[axis] };
+		worldHalfSize += Vector3{ std::abs(row.x), std::abs(row.y), std::abs(row.z) } * halfSize[axis];
 	}
+	boundsMin = center - worldHalfSize;
+	boundsMax = center + worldHalfSize;
+}
 
+bool Renderer::IsSphereOutsideFrustum(const Mesh& mesh, const Frustum& frustum) const
+{
+	const Matrix& world{ mesh.worldMatrix };
+	const float scale{ std::sqrt(std::max({ world.GetAxisX().SqrMagnitude(), world.GetAxisY().SqrMagnitude(), world.GetAxisZ().SqrMagnitude() })) };
+	return frustum.IsOutside(world.TransformPoint(mesh.boundsCenter), mesh.boundsRadius * scale);
 }
 
-void Renderer::RenderTriangleList(const Mesh& currentMesh)
+void Renderer::CullMeshlets(Mesh& mesh, const Frustum& frustum, RenderStats& culledStats) const
 {
-	for (size_t idx = 0; idx < currentMesh.indices.size(); idx+=3)
+	const Matrix& world{ mesh.worldMatrix };
+	const float scale{ std::sqrt(std::max({ world.GetAxisX().SqrMagnitude(), world.GetAxisY().SqrMagnitude(), world.GetAxisZ().SqrMagnitude() })) };
+	const bool useCones{ mesh.cullMode == CullMode::Back };
+
+	mesh.visibleMeshlets_out.clear();
+	mesh.isVertexVisible_out.assign(Mesh::GetVertexStreamStride(mesh.vertices.size()), 0);
+
+	for (uint32_t meshletIdx{}; meshletIdx < mesh.meshlets.size(); ++meshletIdx)
 	{
-		LoopOverPixels(
-			currentMesh.vertices_out[currentMesh.indices[idx]],
-			currentMesh.vertices_out[currentMesh.indices[idx + 1]],
-			currentMesh.vertices_out[currentMesh.indices[idx + 2]]);
+		const Meshlet& meshlet{ mesh.meshlets[meshletIdx] };
+		if (frustum.IsOutside(world.TransformPoint(meshlet.center), meshlet.radius * scale))
+		{
+			++culledStats.nrMeshletsCulled;
+			culledStats.nrTriangles += meshlet.nrTriangles;
+			culledStats.nrFrustumCulled += meshlet.nrTriangles;
+			continue;
+		}
+
+		if (useCones && meshlet.coneCutoff <= 1.f)
+		{
+			const Vector3 apexDirection{ (world.TransformPoint(meshlet.coneApex) - m_Camera.origin).Normalized() };
+			if (Vector3::Dot(apexDirection, world.TransformVector(meshlet.coneAxis).Normalized()) >= meshlet.coneCutoff)
+			{
+				++culledStats.nrMeshletsCulled;
+				culledStats.nrTriangles += meshlet.nrTriangles;
+				culledStats.nrFaceCulled += meshlet.nrTriangles;
+				continue;
+			}
+		}
+
+		mesh.visibleMeshlets_out.push_back(meshletIdx);
+		for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+		{
+			mesh.isVertexVisible_out[mesh.meshletVertices[meshlet.firstVertex + i]] = 1;
+		}
 	}
 }
 
-void Renderer::RenderTriangleStrip(const Mesh& currentMesh)
+void Renderer::BinTriangles(const std::vector<const Mesh*>& meshes)
 {
+	//Ranges of triangles of one mesh, the whole mesh or neighbouring visible meshlets merged
+	struct TriangleSpan
+	{
+		size_t meshIdx;
+		size_t firstTriangle;
+	};
+
+	//Lay the spans out after each other so the work can be split evenly
+	std::vector<TriangleSpan> spans{};
+	std::vector<size_t> firstTriangle{};
 
-	for (size_t idx = 0; idx < currentMesh.indices.size() - 2; ++idx)
+	size_t nrTriangles{};
+	for (size_t meshIdx{}; meshIdx < meshes.size(); ++meshIdx)
 	{
+		const Mesh& mesh{ *meshes[meshIdx] };
+		if (mesh.isVertexVisible_out.empty())
+		{
+			spans.push_back(TriangleSpan{ meshIdx, 0 });
+			firstTriangle.push_back(nrTriangles);
+			nrTriangles += mesh.GetTriangleCount();
+			continue;
+		}
 
-		if (idx % 2 == 0)
+		size_t spanEnd{ SIZE_MAX };
+		for (const uint32_t meshletIdx : mesh.visibleMeshlets_out)
 		{
-			LoopOverPixels(
-				currentMesh.vertices_out[currentMesh.indices[idx]],
-				currentMesh.vertices_out[currentMesh.indices[idx + 1]],
-				currentMesh.vertices_out[currentMesh.indices[idx + 2]]);
+			const Meshlet& meshlet{ mesh.meshlets[meshletIdx] };
+			if (meshlet.firstTriangle != spanEnd)
+			{
+				spans.push_back(TriangleSpan{ meshIdx, meshlet.firstTriangle });
+				firstTriangle.push_back(nrTriangles);
+			}
+			nrTriangles += meshlet.nrTriangles;
+			spanEnd = meshlet.firstTriangle + meshlet.nrTriangles;
 		}
+	}
+	firstTriangle.push_back(nrTriangles);
+
+	const uint32_t nrChunks{ static_cast<uint32_t>(m_BinChunks.size()) };
+	const size_t nrTiles{ static_cast<size_t>(m_NrTilesX * m_NrTilesY) };
+
+	//Every chunk gets a contiguous range, so walking the chunks in order keeps the submission order
+	m_pThreadPool->ParallelFor(nrChunks, [&](uint32_t chunkIdx, uint32_t)
+		{
+			BinChunk& chunk{ m_BinChunks[chunkIdx] };
+			chunk.triangles.clear();
+			chunk.stats = RenderStats{};
+			chunk.tileBins.resize(nrTiles);
+			for (std::vector<uint32_t>& bin : chunk.tileBins)
+			{
+				bin.clear();
+			}
+
+			const size_t begin{ nrTriangles * chunkIdx / nrChunks };
+			const size_t end{ nrTriangles * (chunkIdx + 1) / nrChunks };
+
+			//Cached vertices are only valid for the mesh they came from
+			chunk.vertexCache.Clear();
+
+			size_t spanIdx{};
+			for (size_t triIdx{ begin }; triIdx < end; ++triIdx)
+			{
+				while (triIdx >= firstTriangle[spanIdx + 1])
+				{
+					++spanIdx;
+					if (spans[spanIdx].meshIdx != spans[spanIdx - 1].meshIdx)
+						chunk.vertexCache.Clear();
+				}
+
+				const TriangleSpan& span{ spans[spanIdx] };
+				const Mesh& mesh{ *meshes[span.meshIdx] };
+				uint32_t idx0{}, idx1{}, idx2{};
+				mesh.GetTriangle(span.firstTriangle + triIdx - firstTriangle[spanIdx], idx0, idx1, idx2);
+				++chunk.stats.nrTriangles;
+
+				const uint16_t code0{ mesh.clipCodes_out[idx0] };
+				const uint16_t code1{ mesh.clipCodes_out[idx1] };
+				const uint16_t code2{ mesh.clipCodes_out[idx2] };
+
+				//All vertices outside the same plane
+				if ((code0 & code1 & code2 & Clipping::FrustumPlanes) != 0)
+				{
+					++chunk.stats.nrFrustumCulled;
+					continue;
+				}
+
+				//Common case, everything in front of the camera and inside the guard band
+				const uint16_t clipPlanes{ static_cast<uint16_t>((code0 | code1 | code2) & Clipping::ClipPlanes) };
+				if (clipPlanes == 0)
+				{
+					SetupResult result{};
+					if (!m_UseLazyVertices)
+					{
+						result = BinTriangle(chunk, mesh.vertices_out[idx0], mesh.vertices_out[idx1], mesh.vertices_out[idx2], mesh.cullMode);
+					}
+					else
+					{
+						//Attributes are only worth transforming for a triangle that gets set up
+						result = CullTriangle(mesh.vertices_out[idx0].position, mesh.vertices_out[idx1].position, mesh.vertices_out[idx2].position, mesh.cullMode);
+						if (result == SetupResult::Visible)
+							result = BinTriangle(chunk, FetchVertex(chunk, mesh, idx0), FetchVertex(chunk, mesh, idx1), FetchVertex(chunk, mesh, idx2), mesh.cullMode);
+					}
+
+					if (result == SetupResult::FaceCulled)
+						++chunk.stats.nrFaceCulled;
+					continue;
+				}
+
+				++chunk.stats.nrClipped;
+
+				//Screen space positions of these vertices can be garbage, start again from the clip space positions
+				Clipping::ClipVertex clipTriangle[3]{};
+				const uint32_t indices[3]{ idx0, idx1, idx2 };
+				for (int vertIdx{}; vertIdx < 3; ++vertIdx)
+				{
+					const Vector3& position{ mesh.vertices[indices[vertIdx]].position };
+					clipTriangle[vertIdx].position = mesh.worldViewProjection.TransformPoint(Vector4{ position, 1.f });
+					clipTriangle[vertIdx].vertex = m_UseLazyVertices ? FetchVertex(chunk, mesh, indices[vertIdx]) : mesh.vertices_out[indices[vertIdx]];
+				}
+
+				Clipping::ClipVertex polygon[Clipping::MaxClippedVertices]{};
+				const int nrVertices{ Clipping::ClipTriangle(clipTriangle, clipPlanes, polygon) };
+
+				Vertex_Out projected[Clipping::MaxClippedVertices]{};
+				for (int vertIdx{}; vertIdx < nrVertices; ++vertIdx)
+				{
+					projected[vertIdx] = ProjectClipVertex(polygon[vertIdx]);
+				}
+
+				//Clipped polygon is convex, fan it out in the original winding order
+				//All pieces face the same way, count the original triangle only once
+				bool isFaceCulled{};
+				for (int vertIdx{ 2 }; vertIdx < nrVertices; ++vertIdx)
+				{
+					isFaceCulled |= BinTriangle(chunk, projected[0], projected[vertIdx - 1], projected[vertIdx], mesh.cullMode) == SetupResult::FaceCulled;
+				}
+				if (isFaceCulled)
+					++chunk.stats.nrFaceCulled;
+			}
+		});
+
+	m_Stats = RenderStats{};
+	for (const BinChunk& chunk : m_BinChunks)
+	{
+		m_Stats += chunk.stats;
+	}
+
+	for (const Mesh* pMesh : meshes)
+	{
+		m_Stats.nrVertices += static_cast<uint32_t>(pMesh->vertices.size());
+		if (m_UseLazyVertices)
+			continue;
+
+		if (pMesh->isVertexVisible_out.empty())
+			m_Stats.nrVerticesTransformed += static_cast<uint32_t>(pMesh->vertices.size());
 		else
+			m_Stats.nrVerticesTransformed += static_cast<uint32_t>(std::count(pMesh->isVertexVisible_out.begin(), pMesh->isVertexVisible_out.end(), uint8_t{ 1 }));
+	}
+}
+
+Renderer::SetupResult Renderer::BinTriangle(BinChunk& chunk, const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, CullMode cullMode) const
+{
+	TriangleSetup triangle{};
+	const SetupResult result{ SetupTriangle(v0, v1, v2, cullMode, triangle) };
+	if (result != SetupResult::Visible)
+		return result;
+
+	const uint32_t setupIdx{ static_cast<uint32_t>(chunk.triangles.size()) };
+	chunk.triangles.push_back(triangle);
+
+	for (int ty{ triangle.min.y / TileSize }; ty <= triangle.max.y / TileSize; ++ty)
+	{
+		for (int tx{ triangle.min.x / TileSize }; tx <= triangle.max.x / TileSize; ++tx)
 		{
-			//Fix counterclockwise order
-			LoopOverPixels(
-				currentMesh.vertices_out[currentMesh.indices[idx]], 
-				currentMesh.vertices_out[currentMesh.indices[idx + 2]], 
-				currentMesh.vertices_out[currentMesh.indices[idx + 1]]);
+			chunk.tileBins[ty * m_NrTilesX + tx].push_back(setupIdx);
 		}
+	}
+
+	return result;
+}
+
+Vertex_Out Renderer::ProjectClipVertex(const Clipping::ClipVertex& clipVertex) const
+{
+	Vertex_Out vertex{ clipVertex.vertex };
+
+	const float invW{ 1.f / clipVertex.position.w };
+	vertex.position.x = (clipVertex.position.x * invW + 1) / 2 * m_Width;
+	vertex.position.y = (1 - clipVertex.position.y * invW) / 2 * m_Height;
+	vertex.position.z = clipVertex.position.z * invW;
+	vertex.position.w = clipVertex.position.w;
+
+	return vertex;
+}
+
+void Renderer::RasterizeTiles()
+{
+	const uint32_t clearColor{ SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100) };
+
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_NrTilesX * m_NrTilesY), [&](uint32_t tileIdx, uint32_t)
+		{
+			RasterizeTile(static_cast<int>(tileIdx), clearColor);
+		});
+}
+
+void Renderer::RasterizeTile(int tileIdx, uint32_t clearColor)
+{
+	const Int2 tileMin{ (tileIdx % m_NrTilesX) * TileSize, (tileIdx / m_NrTilesX) * TileSize };
+	const Int2 tileMax{ std::min(tileMin.x + TileSize, m_Width) - 1, std::min(tileMin.y + TileSize, m_Height) - 1 };
+
+	//Clear here so the tile is already in this thread's cache when rasterizing
+	for (int py{ tileMin.y }; py <= tileMax.y; ++py)
+	{
+		const int rowStart{ py * m_Width };
+		std::fill(m_pDepthBufferPixels + rowStart + tileMin.x, m_pDepthBufferPixels + rowStart + tileMax.x + 1, INFINITY);
+		std::fill(m_pBackBufferPixels + rowStart + tileMin.x, m_pBackBufferPixels + rowStart + tileMax.x + 1, clearColor);
+	}
 
+	for (int cellY{ tileMin.y / HiZCellSize }; cellY <= tileMax.y / HiZCellSize; ++cellY)
+	{
+		const int rowStart{ cellY * m_NrHiZCellsX };
+		std::fill(m_pHiZCells + rowStart + tileMin.x / HiZCellSize, m_pHiZCells + rowStart + tileMax.x / HiZCellSize + 1, HiZCell{});
+	}
+
+	for (const BinChunk& chunk : m_BinChunks)
+	{
+		for (const uint32_t triIdx : chunk.tileBins[tileIdx])
+		{
+			(this->*m_pLoopOverPixels)(chunk.triangles[triIdx], tileMin, tileMax);
+		}
 	}
+}
 
+//Frustum culling and clipping already happened in BinTriangles, the guard band keeps the snapped coordinates small
+//Products of two of them still need 64 bit
+static int64_t SnapToSubPixels(float coordinate)
+{
+	return static_cast<int64_t>(std::llround(coordinate * TriangleSetup::SubPixelScale));
+}
 
+Renderer::SetupResult Renderer::CullTriangle(const Vector4& p0, const Vector4& p1, const Vector4& p2, CullMode cullMode) const
+{
+	const int64_t x0{ SnapToSubPixels(p0.x) };
+	const int64_t y0{ SnapToSubPixels(p0.y) };
+	const int64_t x1{ SnapToSubPixels(p1.x) };
+	const int64_t y1{ SnapToSubPixels(p1.y) };
+	const int64_t x2{ SnapToSubPixels(p2.x) };
+	const int64_t y2{ SnapToSubPixels(p2.y) };
+
+	const int64_t signedArea{ (y1 - y0) * (x2 - x0) - (x1 - x0) * (y2 - y0) };
+	if (signedArea == 0)
+		return SetupResult::Empty;
+
+	const bool isBackFacing{ signedArea > 0 };
+	if ((isBackFacing && cullMode == CullMode::Back) || (!isBackFacing && cullMode == CullMode::Front))
+		return SetupResult::FaceCulled;
+
+	//No pixel center inside the bounding box
+	const int64_t minX{ std::max<int64_t>((std::min(std::min(x0, x1), x2) + TriangleSetup::SubPixelScale - 1) >> TriangleSetup::SubPixelBits, 0) };
+	const int64_t minY{ std::max<int64_t>((std::min(std::min(y0, y1), y2) + TriangleSetup::SubPixelScale - 1) >> TriangleSetup::SubPixelBits, 0) };
+	const int64_t maxX{ std::min<int64_t>(std::max(std::max(x0, x1), x2) >> TriangleSetup::SubPixelBits, m_Width - 1) };
+	const int64_t maxY{ std::min<int64_t>(std::max(std::max(y0, y1), y2) >> TriangleSetup::SubPixelBits, m_Height - 1) };
+	if (minX > maxX || minY > maxY)
+		return SetupResult::Empty;
+
+	return SetupResult::Visible;
 }
 
-void Renderer::LoopOverPixels(const Vertex_Out& ver0, const Vertex_Out& ver1, const Vertex_Out& ver2)
+Renderer::SetupResult Renderer::SetupTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, CullMode cullMode, TriangleSetup& triangle) const
 {
 
-	//Frustrum culling
-	if (ver0.position.z < 0.f || ver0.position.z > 1.f)
-		return;
-	if (ver1.position.z < 0.f || ver1.position.z > 1.f)
-		return;
-	if (ver2.position.z < 0.f || ver2.position.z > 1.f)
-		return;
+	const Vertex_Out* pVer0{ &v0 };
+	const Vertex_Out* pVer1{ &v1 };
+	const Vertex_Out* pVer2{ &v2 };
+
+	int64_t x0{ SnapToSubPixels(v0.position.x) };
+	int64_t y0{ SnapToSubPixels(v0.position.y) };
+	int64_t x1{ SnapToSubPixels(v1.position.x) };
+	int64_t y1{ SnapToSubPixels(v1.position.y) };
+	int64_t x2{ SnapToSubPixels(v2.position.x) };
+	int64_t y2{ SnapToSubPixels(v2.position.y) };
+
+	//Twice the area in subpixels, exact
+	//Left handed --> clockwise is negative and faces the camera
+	int64_t signedArea{ (y1 - y0) * (x2 - x0) - (x1 - x0) * (y2 - y0) };
+	if (signedArea == 0)
+		return SetupResult::Empty;
+
+	const bool isBackFacing{ signedArea > 0 };
+	if ((isBackFacing && cullMode == CullMode::Back) || (!isBackFacing && cullMode == CullMode::Front))
+		return SetupResult::FaceCulled;
+
+	if (isBackFacing)
+	{
+		std::swap(pVer1, pVer2);
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		signedArea = -signedArea;
+	}
+
+	//Pixels are sampled at their integer coordinates, so round the min up and the max down
+	const int64_t minX{ std::min(std::min(x0, x1), x2) };
+	const int64_t minY{ std::min(std::min(y0, y1), y2) };
+	const int64_t maxX{ std::max(std::max(x0, x1), x2) };
+	const int64_t maxY{ std::max(std::max(y0, y1), y2) };
+
+	triangle.min.x = static_cast<int>(std::max<int64_t>((minX + TriangleSetup::SubPixelScale - 1) >> TriangleSetup::SubPixelBits, 0));
+	triangle.min.y = static_cast<int>(std::max<int64_t>((minY + TriangleSetup::SubPixelScale - 1) >> TriangleSetup::SubPixelBits, 0));
+	triangle.max.x = static_cast<int>(std::min<int64_t>(maxX >> TriangleSetup::SubPixelBits, m_Width - 1));
+	triangle.max.y = static_cast<int>(std::min<int64_t>(maxY >> TriangleSetup::SubPixelBits, m_Height - 1));
+
+	if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+		return SetupResult::Empty;
+
+	//Same edges as Utils::HitTest_Triangle, cross(pixel - start, end - start) written as a plane in x and y
+	//One pixel step moves SubPixelScale subpixels
+	const int64_t stepX[3]{ y2 - y1, y0 - y2, y1 - y0 };
+	const int64_t stepY[3]{ x1 - x2, x2 - x0, x0 - x1 };
+	const int64_t origin[3]{ x2 * y1 - y2 * x1, x0 * y2 - y0 * x2, x1 * y0 - y1 * x0 };
+
+	for (int edge{}; edge < 3; ++edge)
+	{
+		triangle.edgeStepX[edge] = stepX[edge] * TriangleSetup::SubPixelScale;
+		triangle.edgeStepY[edge] = stepY[edge] * TriangleSetup::SubPixelScale;
+
+		//Top-left rule: pixels exactly on a top or left edge belong to this triangle, on any other edge to the neighbour
+		//Top edges are horizontal with the inside below, left edges have the inside to the right
+		const bool isTopLeft{ stepX[edge] < 0 || (stepX[edge] == 0 && stepY[edge] < 0) };
+		triangle.edgeOrigin[edge] = origin[edge] - (isTopLeft ? 1 : 0);
+	}
+
+	//Planes through the snapped vertices, relative to min so the steps don't get multiplied by large coordinates
+	//Barycentric weight i is e_i / signedArea, so a value only needs its differences to vertex 0 along edges 1 and 2
+	const double invSignedArea{ 1.0 / static_cast<double>(signedArea) };
+	//Without the fill rule bias
+	const double edge1AtMin{ static_cast<double>(triangle.edgeStepX[1] * triangle.min.x + triangle.edgeStepY[1] * triangle.min.y + origin[1]) };
+	const double edge2AtMin{ static_cast<double>(triangle.edgeStepX[2] * triangle.min.x + triangle.edgeStepY[2] * triangle.min.y + origin[2]) };
+	const double stepX1{ static_cast<double>(triangle.edgeStepX[1]) };
+	const double stepX2{ static_cast<double>(triangle.edgeStepX[2]) };
+	const double stepY1{ static_cast<double>(triangle.edgeStepY[1]) };
+	const double stepY2{ static_cast<double>(triangle.edgeStepY[2]) };
+
+	const auto setupPlane{ [&](double value0, double value1, double value2)
+		{
+			const double delta1{ (value1 - value0) * invSignedArea };
+			const double delta2{ (value2 - value0) * invSignedArea };
+			return InterpolationPlane
+			{
+				static_cast<float>(value0 + edge1AtMin * delta1 + edge2AtMin * delta2),
+				static_cast<float>(stepX1 * delta1 + stepX2 * delta2),
+				static_cast<float>(stepY1 * delta1 + stepY2 * delta2)
+			};
+		} };
+
+	const Vertex_Out& ver0{ *pVer0 };
+	const Vertex_Out& ver1{ *pVer1 };
+	const Vertex_Out& ver2{ *pVer2 };
+
+	triangle.depth = setupPlane(ver0.position.z, ver1.position.z, ver2.position.z);
+	triangle.minDepth = std::min(std::min(ver0.position.z, ver1.position.z), ver2.position.z);
+	triangle.maxDepth = std::max(std::max(ver0.position.z, ver1.position.z), ver2.position.z);
+
+	//Everything below is divided by w, position.w still holds the clip space w
+	const double invW0{ 1.0 / ver0.position.w };
+	const double invW1{ 1.0 / ver1.position.w };
+	const double invW2{ 1.0 / ver2.position.w };
+	triangle.invW = setupPlane(invW0, invW1, invW2);
+
+	const uint8_t attributes{ m_InterpolatedAttributes };
+	if (attributes & TriangleSetup::UV)
+	{
+		triangle.uv[0] = setupPlane(ver0.uv.x * invW0, ver1.uv.x * invW1, ver2.uv.x * invW2);
+		triangle.uv[1] = setupPlane(ver0.uv.y * invW0, ver1.uv.y * invW1, ver2.uv.y * invW2);
+	}
 
-	Vector2 v0 = ver0.position.GetXY();
-	Vector2 v1 = ver1.position.GetXY();
-	Vector2 v2 = ver2.position.GetXY();
+	for (int axis{}; axis < 3; ++axis)
+	{
+		if (attributes & TriangleSetup::Normal)
+			triangle.normal[axis] = setupPlane(ver0.normal[axis] * invW0, ver1.normal[axis] * invW1, ver2.normal[axis] * invW2);
+		if (attributes & TriangleSetup::Tangent)
+			triangle.tangent[axis] = setupPlane(ver0.tangent[axis] * invW0, ver1.tangent[axis] * invW1, ver2.tangent[axis] * invW2);
+		if (attributes & TriangleSetup::ViewDirection)
+			triangle.viewDirection[axis] = setupPlane(ver0.viewDirection[axis] * invW0, ver1.viewDirection[axis] * invW1, ver2.viewDirection[axis] * invW2);
+	}
 
-	Vector2 topLeft{};
-	topLeft.x = std::min(std::min(v0.x, v1.x), v2.x);
-	topLeft.y = std::min(std::min(v0.y, v1.y), v2.y);
+	return SetupResult::Visible;
+}
 
-	Vector2 bottomRight{};
-	bottomRight.x = std::max(std::max(v0.x, v1.x), v2.x);
-	bottomRight.y = std::max(std::max(v0.y, v1.y), v2.y);
+constexpr uint8_t Renderer::GetInterpolatedAttributes(ShadingMode shadingMode, bool useNormalMap)
+{
+	//Depth only needs the depth buffer
+	if (shadingMode == ShadingMode::DepthBuffer)
+		return 0;
 
+	//Every other mode starts from the lambert cosine
+	uint8_t attributes{ TriangleSetup::Normal };
+	if (useNormalMap)
+		attributes |= TriangleSetup::UV | TriangleSetup::Tangent;
 
-	Vector3 weight{};
-	for (int px{std::max(0,static_cast<int>(topLeft.x))}; px <= std::min(m_Width, static_cast<int>(bottomRight.x)) ; ++px)
+	switch (shadingMode)
 	{
-		for (int py{std::max(0,static_cast<int>(topLeft.y))}; py <=std::min(m_Height, static_cast<int>(bottomRight.y)); ++py)
+	case ShadingMode::Combined:
+	case ShadingMode::Specular:
+		attributes |= TriangleSetup::UV | TriangleSetup::ViewDirection;
+		break;
+	case ShadingMode::Diffuse:
+		attributes |= TriangleSetup::UV;
+		break;
+	default:
+		break;
+	}
+
+	return attributes;
+}
+
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+void Renderer::LoopOverPixels(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax)
+{
+	if (IsOccluded(triangle, tileMin, tileMax))
+		return;
+
+	PixelBatch batch{};
+	Coverage::TraverseBlocks(m_TraversalOrder, triangle, tileMin, tileMax, [&](int bx, int by)
 		{
-			Vector2 pixel{ static_cast<float>(px), static_cast<float>(py) };
+			//Blocks never straddle two cells
+			HiZCell& cell{ GetHiZCell(bx, by) };
+			if (triangle.minDepth >= cell.maxDepth)
+				return;
+
+			uint32_t mask{};
+			const uint32_t validMask{ Coverage::GetValidMask(bx, by, tileMax) };
+			if (validMask == Coverage::FullBlockMask)
+			{
+				mask = m_TestBlock(triangle, bx, by, m_pDepthBufferPixels, m_Width);
+			}
+			else
+			{
+				//Block sticks out of the screen, only test the lanes that exist
+				mask = Coverage::TestBlock_Scalar(triangle, bx, by, m_pDepthBufferPixels, m_Width, validMask);
+			}
+
+			if (mask != 0)
+				cell.isDirty = true;
 
-			if (Utils::HitTest_Triangle(pixel, v0, v1, v2, weight))
+			//Only pixels that survived coverage and depth test get interpolated and shaded
+			while (mask != 0)
 			{
-				//Z interpolated non-linear
-				float currentDepth = 1.f / (weight.x / ver0.position.z + weight.y / ver1.position.z + weight.z / ver2.position.z);
+				const int lane{ std::countr_zero(mask) };
+				mask &= mask - 1;
 
-				if (currentDepth < m_pDepthBufferPixels[px + (py * m_Width)])
-				{
-					//Z-interpolated, linear
-					float wBuffer{ 1 / (1 / ver0.position.w * weight.x + 1 / ver1.position.w * weight.y + 1 / ver2.position.w * weight.z) };
-					Vector2 uv{};
-					uv = (
-						ver0.uv / ver0.position.w * weight.x +
-						ver1.uv / ver1.position.w * weight.y +
-						ver2.uv / ver2.position.w * weight.z) * wBuffer;
-					
-					ColorRGB col
-					{ (
-						ver0.color * weight.x * ver0.position.w +
-						ver1.color * weight.y * ver1.position.w + 
-						ver2.color * weight.z * ver2.position.w
-						) * wBuffer
-					};
-					Vector3 normal{ (
-						ver0.normal * weight.x * ver0.position.w + 
-						ver1.normal * weight.y * ver1.position.w + 
-						ver2.normal * weight.z * ver2.position.w) * wBuffer };
-				
-					normal.Normalize();
-
-					Vector3 tangent{(
-						ver0.tangent * weight.x * ver0.position.w + 
-						ver1.tangent * weight.y * ver1.position.w + 
-						ver2.tangent * weight.z * ver2.position.w) * wBuffer};
-					tangent.Normalize();
-
-					Vector3 viewDir{ (
-						ver0.viewDirection * weight.x * ver0.position.w + 
-						ver1.viewDirection * weight.y * ver1.position.w + 
-						ver2.viewDirection * weight.z * ver2.position.w) * wBuffer };
-					viewDir.Normalize();
-
-					Vertex_Out currentPixel
-					{
-						Vector4{static_cast<float>(px),static_cast<float>(py),currentDepth,wBuffer},
-						col,
-						uv,
-						normal,
-						tangent,
-						viewDir
-					};
-
-					m_pDepthBufferPixels[px + (py * m_Width)] = currentDepth;
-				
-					PixelShading(currentPixel);
-				}
+				if (batch.count == Texture::SampleBatchSize)
+					ShadeBatch<Mode, UseNormalMap>(batch);
 
+				const int px{ bx + lane % Coverage::BlockWidth };
+				const int py{ by + lane / Coverage::BlockWidth };
+				const int idx{ batch.count++ };
+				InterpolatePixel<Mode, UseNormalMap>(triangle, px, py, m_pDepthBufferPixels[px + (py * m_Width)], batch.pixels[idx], batch.uvDx[idx], batch.uvDy[idx]);
+				batch.uvs[idx] = batch.pixels[idx].uv;
 			}
+		});
+
+	ShadeBatch<Mode, UseNormalMap>(batch);
+}
+
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+void Renderer::ShadeBatch(PixelBatch& batch)
+{
+	MaterialSample materials[Texture::SampleBatchSize]{};
+	if constexpr (Mode == ShadingMode::Combined)
+		m_pVehicleMaterial->SampleBatch(batch.uvs, batch.uvDx, batch.uvDy, batch.count, m_TextureFilter, m_TextureAddress, materials);
+
+	for (int idx{}; idx < batch.count; ++idx)
+	{
+		PixelShading<Mode, UseNormalMap>(batch.pixels[idx], batch.uvDx[idx], batch.uvDy[idx], materials[idx]);
+	}
+
+	batch.count = 0;
+}
+
+Renderer::HiZCell& Renderer::GetHiZCell(int px, int py)
+{
+	HiZCell& cell{ m_pHiZCells[(py / HiZCellSize) * m_NrHiZCellsX + px / HiZCellSize] };
+	if (!cell.isDirty)
+		return cell;
+
+	//Only recalculated when someone needs it, so a cell written by many triangles in a row is scanned once
+	const int minX{ px / HiZCellSize * HiZCellSize };
+	const int minY{ py / HiZCellSize * HiZCellSize };
+	const int maxX{ std::min(minX + HiZCellSize, m_Width) };
+	const int maxY{ std::min(minY + HiZCellSize, m_Height) };
+
+	float maxDepth{};
+	for (int y{ minY }; y < maxY; ++y)
+	{
+		const float* pRow{ m_pDepthBufferPixels + y * m_Width };
+		for (int x{ minX }; x < maxX; ++x)
+		{
+			maxDepth = std::max(maxDepth, pRow[x]);
 		}
 	}
 
+	cell.maxDepth = maxDepth;
+	cell.isDirty = false;
+	return cell;
 }
 
-void Renderer::PixelShading(const Vertex_Out& v)
+bool Renderer::IsOccluded(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax)
 {
-	ColorRGB finalColor{};
-	float remapped{};
-	const float intensity{ 7.f };
-	const float shininess{ 25.f };
-	
-	Vector3 binormal{ Vector3::Cross(v.normal,v.tangent) };
-	Matrix tangentSpaceAxis = Matrix{ v.tangent,binormal,v.normal,Vector3::Zero };
+	const int minX{ std::max(tileMin.x, triangle.min.x) };
+	const int maxX{ std::min(tileMax.x, triangle.max.x) };
+	const int minY{ std::max(tileMin.y, triangle.min.y) };
+	const int maxY{ std::min(tileMax.y, triangle.max.y) };
+
+	for (int cellY{ minY / HiZCellSize }; cellY <= maxY / HiZCellSize; ++cellY)
+	{
+		for (int cellX{ minX / HiZCellSize }; cellX <= maxX / HiZCellSize; ++cellX)
+		{
+			if (triangle.minDepth < GetHiZCell(cellX * HiZCellSize, cellY * HiZCellSize).maxDepth)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+void Renderer::InterpolatePixel(const TriangleSetup& triangle, int px, int py, float currentDepth, Vertex_Out& currentPixel, Vector2& uvDx, Vector2& uvDy) const
+{
+	const float dx{ static_cast<float>(px - triangle.min.x) };
+	const float dy{ static_cast<float>(py - triangle.min.y) };
+
+	//Perspective correct, one reciprocal for all attributes
+	const float w{ 1.f / triangle.invW.Evaluate(dx, dy) };
+
+	currentPixel.position = Vector4{ static_cast<float>(px), static_cast<float>(py), currentDepth, w };
+
+	constexpr uint8_t attributes{ GetInterpolatedAttributes(Mode, UseNormalMap) };
+	if constexpr ((attributes & TriangleSetup::UV) != 0)
+	{
+		currentPixel.uv = Vector2{ triangle.uv[0].Evaluate(dx, dy), triangle.uv[1].Evaluate(dx, dy) } * w;
+
+		//Exact screen space derivatives for the mip selection, straight from the planes instead of differencing neighbours
+		//d(P / Q) = (dP - P / Q * dQ) / Q, with uv = P / Q and 1 / Q = w
+		uvDx = (Vector2{ triangle.uv[0].stepX, triangle.uv[1].stepX } - currentPixel.uv * triangle.invW.stepX) * w;
+		uvDy = (Vector2{ triangle.uv[0].stepY, triangle.uv[1].stepY } - currentPixel.uv * triangle.invW.stepY) * w;
+	}
+
+	//Directions get normalized anyway, so they can skip the multiplication by w
+	if constexpr ((attributes & TriangleSetup::Normal) != 0)
+		currentPixel.normal = Vector3{ triangle.normal[0].Evaluate(dx, dy), triangle.normal[1].Evaluate(dx, dy), triangle.normal[2].Evaluate(dx, dy) }.Normalized();
+	if constexpr ((attributes & TriangleSetup::Tangent) != 0)
+		currentPixel.tangent = Vector3{ triangle.tangent[0].Evaluate(dx, dy), triangle.tangent[1].Evaluate(dx, dy), triangle.tangent[2].Evaluate(dx, dy) }.Normalized();
+	if constexpr ((attributes & TriangleSetup::ViewDirection) != 0)
+		currentPixel.viewDirection = Vector3{ triangle.viewDirection[0].Evaluate(dx, dy), triangle.viewDirection[1].Evaluate(dx, dy), triangle.viewDirection[2].Evaluate(dx, dy) }.Normalized();
+}
 
-	ColorRGB normalSample{ m_pVehicleNormal->Sample(v.uv) };
-	Vector3 normalSampleVec{ normalSample.r,normalSample.g,normalSample.b };
+Renderer::LoopFunction Renderer::SelectLoopOverPixels() const
+{
+	switch (m_CurrentShadingMode)
+	{
+	case ShadingMode::Combined:
+		return SelectLoopOverPixels<ShadingMode::Combined>(m_UseNormalMap);
+	case ShadingMode::Diffuse:
+		return SelectLoopOverPixels<ShadingMode::Diffuse>(m_UseNormalMap);
+	case ShadingMode::ObservedArea:
+		return SelectLoopOverPixels<ShadingMode::ObservedArea>(m_UseNormalMap);
+	case ShadingMode::Specular:
+		return SelectLoopOverPixels<ShadingMode::Specular>(m_UseNormalMap);
+	default:
+		return SelectLoopOverPixels<ShadingMode::DepthBuffer>(false);
+	}
+}
 
-	Vector3 normal{ 2.f * normalSampleVec - Vector3{1.f,1.f,1.f} };
-	normal = m_UseNormalMap ? tangentSpaceAxis.TransformVector(normal).Normalized(): v.normal;
+template<Renderer::ShadingMode Mode>
+Renderer::LoopFunction Renderer::SelectLoopOverPixels(bool useNormalMap)
+{
+	return useNormalMap ? &Renderer::LoopOverPixels<Mode, true> : &Renderer::LoopOverPixels<Mode, false>;
+}
 
-	const float lambertCosine{ Vector3::Dot(normal, -m_LightDirection) };
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+void Renderer::PixelShading(const Vertex_Out& v, const Vector2& uvDx, const Vector2& uvDy, const MaterialSample& material)
+{
+	ColorRGB finalColor{};
 
-	if (m_CurrentShadingMode == ShadingMode::DepthBuffer)
+	if constexpr (Mode == ShadingMode::DepthBuffer)
 	{
-		remapped = Remap(v.position.z);
+		const float remapped{ Remap(v.position.z) };
 		finalColor = { remapped,remapped,remapped };
 	}
 	else
 	{
-		if (lambertCosine > 0.f)
+		Vector3 normal{ v.normal };
+		if constexpr (UseNormalMap)
 		{
-			//Phong
-			Vector3 reflect = -m_LightDirection - 2 * std::max(Vector3::Dot(normal, -m_LightDirection), 0.f) * normal;
-			float alpha = std::max(Vector3::Dot(reflect, v.viewDirection), 0.f);
-			ColorRGB specular = m_pVehicleSpecular->Sample(v.uv) * powf(alpha, shininess * m_pVehicleGloss->Sample(v.uv).r);
+			Vector3 binormal{ Vector3::Cross(v.normal,v.tangent) };
+			Matrix tangentSpaceAxis = Matrix{ v.tangent,binormal,v.normal,Vector3::Zero };
 
-			specular.r = std::max(0.f, specular.r);
-			specular.g = std::max(0.f, specular.g);
-			specular.b = std::max(0.f, specular.b);
+			ColorRGB normalSample{ Mode == ShadingMode::Combined ? material.normal : m_pVehicleMaterial->SampleChannel(MaterialChannel::Normal, v.uv, uvDx, uvDy, m_TextureFilter, m_TextureAddress) };
+			Vector3 normalSampleVec{ normalSample.r,normalSample.g,normalSample.b };
+
+			normal = tangentSpaceAxis.TransformVector(2.f * normalSampleVec - Vector3{ 1.f,1.f,1.f }).Normalized();
+		}
 
-			ColorRGB ambient{ .025f,.025f, .025f };
-			ColorRGB diffuse{ Utils::Lambert(intensity, m_pVehicleDiffuse->Sample(v.uv)) };
+		const float lambertCosine{ Vector3::Dot(normal, -m_LightDirection) };
 
-			switch (m_CurrentShadingMode)
+		if (lambertCosine > 0.f)
+		{
+			if constexpr (Mode == ShadingMode::ObservedArea)
 			{
-			case ShadingMode::Combined:
-				finalColor = (diffuse + specular + ambient) * lambertCosine;
-				break;
-			case ShadingMode::Diffuse:
-				finalColor = diffuse * lambertCosine;
-				break;
-			case ShadingMode::ObservedArea:
 				finalColor = ColorRGB{ lambertCosine,lambertCosine,lambertCosine };
-				break;
-			case ShadingMode::Specular:
-				finalColor = specular * lambertCosine;
-				break;
+			}
+			else
+			{
+				const float intensity{ 7.f };
+				const float shininess{ 25.f };
+
+				ColorRGB diffuse{};
+				if constexpr (Mode == ShadingMode::Combined)
+					diffuse = Utils::Lambert(intensity, material.diffuse);
+				else if constexpr (Mode == ShadingMode::Diffuse)
+					diffuse = Utils::Lambert(intensity, m_pVehicleMaterial->SampleChannel(MaterialChannel::Diffuse, v.uv, uvDx, uvDy, m_TextureFilter, m_TextureAddress));
+
+				ColorRGB specular{};
+				if constexpr (Mode == ShadingMode::Combined || Mode == ShadingMode::Specular)
+				{
+					//Phong
+					Vector3 reflect = -m_LightDirection - 2 * std::max(Vector3::Dot(normal, -m_LightDirection), 0.f) * normal;
+					float alpha = std::max(Vector3::Dot(reflect, v.viewDirection), 0.f);
+					if constexpr (Mode == ShadingMode::Combined)
+					{
+						specular = material.specular * powf(alpha, shininess * material.gloss);
+					}
+					else
+					{
+						const float gloss{ m_pVehicleMaterial->SampleChannel(MaterialChannel::Gloss, v.uv, uvDx, uvDy, m_TextureFilter, m_TextureAddress).r };
+						specular = m_pVehicleMaterial->SampleChannel(MaterialChannel::Specular, v.uv, uvDx, uvDy, m_TextureFilter, m_TextureAddress) * powf(alpha, shininess * gloss);
+					}
+
+					specular.r = std::max(0.f, specular.r);
+					specular.g = std::max(0.f, specular.g);
+					specular.b = std::max(0.f, specular.b);
+				}
+
+				if constexpr (Mode == ShadingMode::Combined)
+				{
+					ColorRGB ambient{ .025f,.025f, .025f };
+					finalColor = (diffuse + specular + ambient) * lambertCosine;
+				}
+				else if constexpr (Mode == ShadingMode::Diffuse)
+				{
+					finalColor = diffuse * lambertCosine;
+				}
+				else
+				{
+					finalColor = specular * lambertCosine;
+				}
 			}
 		}
 	}
@@ -1,24 +1,33 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
 #include <vector>
 
 #include "Camera.h"
+#include "Clipping.h"
+#include "Coverage.h"
 #include "DataTypes.h"
+#include "Material.h"
+#include "SceneBVH.h"
+#include "Texture.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
-	class Texture;
 	struct Mesh;
 	struct Vertex;
 	class Timer;
 	class Scene;
+	class ThreadPool;
 
 	class Renderer final
 	{
+		friend class Benchmark;
+
 	public:
 		Renderer(SDL_Window* pWindow);
 		~Renderer();
@@ -36,15 +45,88 @@ namespace dae
 		void ToggleShadingMode();
 		void ToggleDepthBuffer();
 		void ToggleNormalMap();
+		void ToggleTextureFilter();
+		void ToggleTextureAddress();
+		//Reloads the vehicle material block compressed or back to uncompressed
+		void ToggleBlockCompression();
+		//Transforms the vertex attributes on demand while binning instead of for every vertex up front
+		void ToggleLazyVertices();
+		//Culls meshlets that are outside the frustum or face away before the vertex stage
+		void ToggleMeshletCulling();
 
 		bool SaveBufferToImage() const;
 
+		const RenderStats& GetStats() const { return m_Stats; }
+
 	private:
 		enum class ShadingMode
 		{
 			Combined, Diffuse, ObservedArea, Specular, DepthBuffer
 		};
 
+		//Screen is split in square tiles, every tile is rasterized by exactly one thread
+		static constexpr int TileSize{ 64 };
+
+		//Vertices are transformed in jobs of this many on the thread pool, a multiple of the 8 the AVX2 path does at once
+		static constexpr size_t VerticesPerJob{ 2048 };
+
+		//Coarse depth buffer, one cell per HiZCellSize x HiZCellSize pixels
+		//A triangle or block that can't get closer than maxDepth fails the depth test on every pixel of the cell
+		static constexpr int HiZCellSize{ 8 };
+		struct HiZCell
+		{
+			float maxDepth{ INFINITY };
+			//Depth was written since maxDepth was calculated
+			bool isDirty{};
+		};
+
+		enum class SetupResult
+		{
+			Visible,
+			FaceCulled,
+			//Degenerate or outside the screen
+			Empty
+		};
+
+		//Rasterizes one triangle inside one tile, specialized on everything PixelShading needs to know
+		using LoopFunction = void(Renderer::*)(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax);
+
+		//Post-transform cache of one binning job, direct mapped on the vertex index
+		//With lazy vertices the attributes of a vertex are transformed into it when a triangle that survived culling misses
+		struct VertexCache
+		{
+			static constexpr uint32_t Size{ 64 };
+			static constexpr uint32_t NoVertex{ UINT32_MAX };
+
+			uint32_t vertexIndices[Size]{};
+			Vertex_Out vertices[Size]{};
+
+			void Clear()
+			{
+				std::fill(std::begin(vertexIndices), std::end(vertexIndices), NoVertex);
+			}
+		};
+
+		//Triangles set up by one binning job, tileBins[tile] holds indices into triangles
+		struct BinChunk
+		{
+			std::vector<TriangleSetup> triangles{};
+			std::vector<std::vector<uint32_t>> tileBins{};
+			RenderStats stats{};
+			VertexCache vertexCache{};
+		};
+
+		//Covered pixels of one triangle, shaded a batch at a time so their texture fetches can be done together
+		struct PixelBatch
+		{
+			Vertex_Out pixels[Texture::SampleBatchSize]{};
+			//Copy of the uvs, SampleBatch needs them next to each other
+			Vector2 uvs[Texture::SampleBatchSize]{};
+			Vector2 uvDx[Texture::SampleBatchSize]{};
+			Vector2 uvDy[Texture::SampleBatchSize]{};
+			int count{};
+		};
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
@@ -52,18 +134,25 @@ namespace dae
 		uint32_t* m_pBackBufferPixels{};
 
 		float* m_pDepthBufferPixels{};
+		HiZCell* m_pHiZCells{};
+		int m_NrHiZCellsX{};
+		int m_NrHiZCellsY{};
 
 		Texture* m_pTextureGrid;
 		Texture* m_pTuktukTexture;
 
-		Texture* m_pVehicleDiffuse;
-		Texture* m_pVehicleNormal;
-		Texture* m_pVehicleSpecular;
-		Texture* m_pVehicleGloss;
+		Material* m_pVehicleMaterial{};
 
 		Camera m_Camera{};
 
 		std::vector<Mesh> m_MeshesWorld;
+		//Indices into m_MeshesWorld that Render_Week2 draws, the tuktuk is loaded but not drawn
+		std::vector<uint32_t> m_SceneMeshes{ 1 };
+		//Over the world space boxes of m_SceneMeshes, ids are their indices into m_MeshesWorld
+		SceneBVH m_SceneBVH{};
+		uint32_t m_NrSceneTriangles{};
+		uint32_t m_NrSceneVertices{};
+		std::vector<uint32_t> m_VisibleMeshes{};
 
 		int m_Width{};
 		int m_Height{};
@@ -72,18 +161,91 @@ namespace dae
 		ShadingMode m_ShadingMode{ ShadingMode::Diffuse };
 		bool m_ShadeDepth;
 		bool m_UseNormalMap;
+		TextureFilter m_TextureFilter{ TextureFilter::Trilinear };
+		TextureAddress m_TextureAddress{ TextureAddress::Clamp };
+		bool m_UseBlockCompression{};
+		bool m_UseLazyVertices{ true };
+		bool m_UseMeshletCulling{ true };
 
 		Vector3 m_LightDirection{ .577f,-.577f,.577f };
 
-		//Function that transforms the vertices from the mesh from World space to Screen space
-		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const; //W1 Version
-		void VertexTransformationFunction(Mesh& mesh) const; //W2 Version
+		ThreadPool* m_pThreadPool{};
+		std::vector<BinChunk> m_BinChunks{};
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+		Coverage::BlockFunction m_TestBlock{};
+		Coverage::TraversalOrder m_TraversalOrder{ Coverage::TraversalOrder::Blocked };
+		RenderStats m_Stats{};
+		uint8_t m_InterpolatedAttributes{};
+		LoopFunction m_pLoopOverPixels{};
 
-		void RenderTriangleList(const Mesh& currentMesh);
-		void RenderTriangleStrip(const Mesh& currentMesh);
-		void LoopOverPixels(const Vertex_Out& ver0, const Vertex_Out& ver1, const Vertex_Out& ver2);
+		//(Re)loads the vehicle maps into one material with the given texel layout, or block compressed
+		void LoadVehicleMaterial(TextureLayout layout, bool isBlockCompressed = false);
 
-		void PixelShading(const Vertex_Out& v);
+		//Function that transforms the vertices from the mesh from World space to Screen space
+		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const; //W1 Version
+		//W2 Version, with positionsOnly the attributes are left for FetchVertex and only the positions and clip codes are set
+		//Only transforms vertices that Mesh::isVertexVisible_out marks, in whole groups of 8
+		void VertexTransformationFunction(Mesh& mesh, bool positionsOnly = false) const;
+		void TransformVertexRange(Mesh& mesh, bool positionsOnly, bool useAVX2, size_t begin, size_t end) const;
+		//Screen position (w stays the clip space w) and clip code of one vertex into vertices_out and clipCodes_out
+		void TransformVertexPosition(Mesh& mesh, size_t vertexIdx) const;
+		//Everything but the position of one vertex
+		void TransformVertexAttributes(const Mesh& mesh, size_t vertexIdx, Vertex_Out& vertex) const;
+		//Vertex with its attributes from the post-transform cache of the chunk, transformed first on a miss
+		Vertex_Out FetchVertex(BinChunk& chunk, const Mesh& mesh, uint32_t vertexIdx) const;
+
+		//(Re)builds m_SceneBVH over the current world matrices of m_SceneMeshes, needed again when a scene mesh is replaced
+		void BuildSceneBVH();
+		//Call after changing the world matrix or the bounds of a mesh, its box in m_SceneBVH is refit at the start of the next frame
+		void OnMeshMoved(uint32_t meshIdx);
+		//World space box around the transformed bounding box of the mesh
+		static void GetWorldBounds(const Mesh& mesh, Vector3& boundsMin, Vector3& boundsMax);
+		//World space bounding sphere, scaled by the largest axis of the world matrix
+		bool IsSphereOutsideFrustum(const Mesh& mesh, const Frustum& frustum) const;
+		//Fills in Mesh::visibleMeshlets_out and Mesh::isVertexVisible_out, adds the triangles of culled meshlets to culledStats
+		//Normal cones are only used with CullMode::Back and assume the world matrix doesn't scale unevenly
+		void CullMeshlets(Mesh& mesh, const Frustum& frustum, RenderStats& culledStats) const;
+
+		//Sets up the triangles of all meshes, of their visible meshlets if they were culled, and sorts them into the screen tiles they overlap
+		//Triangles crossing the near/far plane or the guard band are clipped first
+		void BinTriangles(const std::vector<const Mesh*>& meshes);
+		//Sets up a triangle and adds it to every tile its bounding box overlaps
+		SetupResult BinTriangle(BinChunk& chunk, const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, CullMode cullMode) const;
+		Vertex_Out ProjectClipVertex(const Clipping::ClipVertex& clipVertex) const;
+		//Clears and rasterizes every tile in parallel, tiles don't share pixels so no locking is needed
+		void RasterizeTiles();
+		//Same facing and empty tests SetupTriangle starts with, on the screen positions only
+		SetupResult CullTriangle(const Vector4& p0, const Vector4& p1, const Vector4& p2, CullMode cullMode) const;
+		//Culls on facing and computes the screen bounding box, edge functions and interpolation planes
+		//Visible back faces get their winding flipped, so the rasterizer only ever sees front faces
+		SetupResult SetupTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, CullMode cullMode, TriangleSetup& triangle) const;
+		void RasterizeTile(int tileIdx, uint32_t clearColor);
+		template<ShadingMode Mode, bool UseNormalMap>
+		void LoopOverPixels(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax);
+		//Samples the material for every pixel in the batch at once, shades them and empties the batch
+		template<ShadingMode Mode, bool UseNormalMap>
+		void ShadeBatch(PixelBatch& batch);
+		//Interpolates the attributes the mode reads, uvDx and uvDy are only set when it reads uv
+		template<ShadingMode Mode, bool UseNormalMap>
+		void InterpolatePixel(const TriangleSetup& triangle, int px, int py, float currentDepth, Vertex_Out& currentPixel, Vector2& uvDx, Vector2& uvDy) const;
+
+		//Variant of LoopOverPixels for the current shading mode and normal map setting
+		LoopFunction SelectLoopOverPixels() const;
+		template<ShadingMode Mode>
+		static LoopFunction SelectLoopOverPixels(bool useNormalMap);
+		//TriangleSetup::Attribute flags of everything PixelShading reads in that mode
+		static constexpr uint8_t GetInterpolatedAttributes(ShadingMode shadingMode, bool useNormalMap);
+
+		//Returns the cell containing the pixel, recalculating its max depth first if needed
+		HiZCell& GetHiZCell(int px, int py);
+		//True if every HiZ cell the triangle overlaps inside the tile is already closer than the triangle
+		bool IsOccluded(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax);
+
+		//Only fetches the textures and computes the terms the mode shows
+		//Combined gets its material already sampled with the rest of the batch, the debug modes sample per map themselves
+		template<ShadingMode Mode, bool UseNormalMap>
+		void PixelShading(const Vertex_Out& v, const Vector2& uvDx, const Vector2& uvDy, const MaterialSample& material);
 
 
 		
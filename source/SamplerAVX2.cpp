@@ -0,0 +1,100 @@
+#include "SamplerAVX2.h"
+
+namespace dae
+{
+	namespace SamplerAVX2
+	{
+		//Mathematical modulo, the float division can be one off, which the fix up after it takes care of
+		static __m256i Modulo(__m256i coord, int size)
+		{
+			const __m256i sizes{ _mm256_set1_epi32(size) };
+			const __m256 quotient{ _mm256_floor_ps(_mm256_div_ps(_mm256_cvtepi32_ps(coord), _mm256_set1_ps(static_cast<float>(size)))) };
+			__m256i result{ _mm256_sub_epi32(coord, _mm256_mullo_epi32(_mm256_cvttps_epi32(quotient), sizes)) };
+
+			result = _mm256_add_epi32(result, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), result), sizes));
+			result = _mm256_sub_epi32(result, _mm256_andnot_si256(_mm256_cmpgt_epi32(sizes, result), sizes));
+			return result;
+		}
+
+		//Same as Texture::ApplyAddress
+		static __m256i ApplyAddress(__m256i coord, int size, TextureAddress address)
+		{
+			switch (address)
+			{
+			case TextureAddress::Wrap:
+				return Modulo(coord, size);
+			case TextureAddress::Mirror:
+			{
+				const __m256i inPeriod{ Modulo(coord, 2 * size) };
+				const __m256i mirrored{ _mm256_sub_epi32(_mm256_set1_epi32(2 * size - 1), inPeriod) };
+				return _mm256_blendv_epi8(mirrored, inPeriod, _mm256_cmpgt_epi32(_mm256_set1_epi32(size), inPeriod));
+			}
+			default:
+				return _mm256_min_epi32(_mm256_max_epi32(coord, _mm256_setzero_si256()), _mm256_set1_epi32(size - 1));
+			}
+		}
+
+		//Same as Texture::SpreadBits
+		static __m256i SpreadBits(__m256i value)
+		{
+			value = _mm256_and_si256(value, _mm256_set1_epi32(0x0000FFFF));
+			value = _mm256_and_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 8)), _mm256_set1_epi32(0x00FF00FF));
+			value = _mm256_and_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+			value = _mm256_and_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 2)), _mm256_set1_epi32(0x33333333));
+			value = _mm256_and_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 1)), _mm256_set1_epi32(0x55555555));
+			return value;
+		}
+
+		//Same as Texture::GetTexelIndex
+		template<int TileShift>
+		static __m256i GetTiledIndex(__m256i x, __m256i y, int nrTilesX)
+		{
+			const __m256i tileMask{ _mm256_set1_epi32((1 << TileShift) - 1) };
+			const __m256i tile{ _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, TileShift), _mm256_set1_epi32(nrTilesX)), _mm256_srli_epi32(x, TileShift)) };
+			const __m256i inTile{ _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(y, tileMask), TileShift), _mm256_and_si256(x, tileMask)) };
+			return _mm256_add_epi32(_mm256_slli_epi32(tile, 2 * TileShift), inTile);
+		}
+
+		static __m256i GetTexelIndex(__m256i x, __m256i y, int width, int nrTilesX, TextureLayout layout)
+		{
+			switch (layout)
+			{
+			case TextureLayout::Tiled4x4:
+				return GetTiledIndex<2>(x, y, nrTilesX);
+			case TextureLayout::Tiled8x8:
+				return GetTiledIndex<3>(x, y, nrTilesX);
+			case TextureLayout::Morton:
+				return _mm256_or_si256(SpreadBits(x), _mm256_slli_epi32(SpreadBits(y), 1));
+			default:
+				return _mm256_add_epi32(x, _mm256_mullo_epi32(y, _mm256_set1_epi32(width)));
+			}
+		}
+
+		Footprint GetFootprint(__m256 u, __m256 v, int width, int height, int nrTilesX, TextureLayout layout, TextureAddress address)
+		{
+			//Texel centers sit at half coordinates
+			const __m256 x{ _mm256_sub_ps(_mm256_mul_ps(u, _mm256_set1_ps(static_cast<float>(width))), _mm256_set1_ps(0.5f)) };
+			const __m256 y{ _mm256_sub_ps(_mm256_mul_ps(v, _mm256_set1_ps(static_cast<float>(height))), _mm256_set1_ps(0.5f)) };
+			const __m256 floorX{ _mm256_floor_ps(x) };
+			const __m256 floorY{ _mm256_floor_ps(y) };
+
+			const __m256i left{ _mm256_cvttps_epi32(floorX) };
+			const __m256i top{ _mm256_cvttps_epi32(floorY) };
+			const __m256i one{ _mm256_set1_epi32(1) };
+
+			const __m256i x0{ ApplyAddress(left, width, address) };
+			const __m256i x1{ ApplyAddress(_mm256_add_epi32(left, one), width, address) };
+			const __m256i y0{ ApplyAddress(top, height, address) };
+			const __m256i y1{ ApplyAddress(_mm256_add_epi32(top, one), height, address) };
+
+			Footprint footprint{};
+			footprint.texels[0] = GetTexelIndex(x0, y0, width, nrTilesX, layout);
+			footprint.texels[1] = GetTexelIndex(x1, y0, width, nrTilesX, layout);
+			footprint.texels[2] = GetTexelIndex(x0, y1, width, nrTilesX, layout);
+			footprint.texels[3] = GetTexelIndex(x1, y1, width, nrTilesX, layout);
+			footprint.weightX = _mm256_sub_ps(x, floorX);
+			footprint.weightY = _mm256_sub_ps(y, floorY);
+			return footprint;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <immintrin.h>
+#include "Texture.h"
+
+namespace dae
+{
+	//Building blocks of the 8 wide bilinear path of Texture::SampleBatch and Material::SampleBatch
+	//Only call these when CpuFeatures::HasAVX2()
+	namespace SamplerAVX2
+	{
+		//Texel indices and weights of 8 bilinear footprints in one mip level
+		struct Footprint
+		{
+			//Top left, top right, bottom left, bottom right
+			__m256i texels[4];
+			__m256 weightX;
+			__m256 weightY;
+		};
+
+		//Same texels and weights as the scalar SampleBilinear, indices are in the order of layout
+		Footprint GetFootprint(__m256 u, __m256 v, int width, int height, int nrTilesX, TextureLayout layout, TextureAddress address);
+
+		//Same as Lerpf, so the result matches the scalar path bit for bit
+		inline __m256 Lerp(__m256 a, __m256 b, __m256 factor)
+		{
+			return _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), factor), a), _mm256_mul_ps(factor, b));
+		}
+
+		//One byte of 8 packed texels to [0, 1], divided like Texture::ByteToFloat
+		template<int Shift>
+		inline __m256 UnpackChannel(__m256i texels)
+		{
+			const __m256i bytes{ _mm256_and_si256(_mm256_srli_epi32(texels, Shift), _mm256_set1_epi32(0xFF)) };
+			return _mm256_div_ps(_mm256_cvtepi32_ps(bytes), _mm256_set1_ps(255.f));
+		}
+
+		//Bilinear blend of one channel of the four corners of a footprint
+		template<int Shift>
+		inline __m256 FilterChannel(const __m256i (&corners)[4], const Footprint& footprint)
+		{
+			const __m256 top{ Lerp(UnpackChannel<Shift>(corners[0]), UnpackChannel<Shift>(corners[1]), footprint.weightX) };
+			const __m256 bottom{ Lerp(UnpackChannel<Shift>(corners[2]), UnpackChannel<Shift>(corners[3]), footprint.weightX) };
+			return Lerp(top, bottom, footprint.weightY);
+		}
+	}
+}
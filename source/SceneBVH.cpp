@@ -0,0 +1,352 @@
+#include "SceneBVH.h"
+
+//Standard includes
+#include <algorithm>
+#include <cfloat>
+
+namespace dae
+{
+	static Vector3 Min(const Vector3& v1, const Vector3& v2)
+	{
+		return Vector3{ std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z) };
+	}
+
+	static Vector3 Max(const Vector3& v1, const Vector3& v2)
+	{
+		return Vector3{ std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z) };
+	}
+
+	//Half the surface area, the SAH only compares them
+	static float GetArea(const Vector3& boundsMin, const Vector3& boundsMax)
+	{
+		const Vector3 size{ boundsMax - boundsMin };
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	static Vector3 GetCentroid(const SceneBVH::Item& item)
+	{
+		return (item.boundsMin + item.boundsMax) * 0.5f;
+	}
+
+	void SceneBVH::Build(const std::vector<Item>& items)
+	{
+		m_Nodes.clear();
+		m_Items = items;
+		m_NrDirtyNodes = 0;
+		m_ItemLeaves.assign(items.size(), NoNode);
+		m_ItemPositions.clear();
+		if (items.empty())
+			return;
+
+		//A binary tree with leaves of one or more items has less than twice as many nodes as items
+		m_Nodes.reserve(items.size() * 2);
+		m_Nodes.emplace_back(Node{});
+		m_Nodes[0].nrItems = static_cast<uint32_t>(items.size());
+		UpdateNodeBounds(0);
+		Subdivide(0);
+
+		uint32_t maxId{};
+		for (const Item& item : m_Items)
+		{
+			maxId = std::max(maxId, item.id);
+		}
+		m_ItemPositions.assign(static_cast<size_t>(maxId) + 1, NoNode);
+		for (uint32_t position{}; position < m_Items.size(); ++position)
+		{
+			m_ItemPositions[m_Items[position].id] = position;
+		}
+
+		for (uint32_t nodeIdx{}; nodeIdx < m_Nodes.size(); ++nodeIdx)
+		{
+			const Node& node{ m_Nodes[nodeIdx] };
+			if (node.leftChild != NoNode)
+				continue;
+
+			std::fill_n(m_ItemLeaves.begin() + node.firstItem, node.nrItems, nodeIdx);
+		}
+	}
+
+	void SceneBVH::Subdivide(uint32_t nodeIdx)
+	{
+		const uint32_t firstItem{ m_Nodes[nodeIdx].firstItem };
+		const uint32_t nrItems{ m_Nodes[nodeIdx].nrItems };
+		if (nrItems <= 1)
+			return;
+
+		//Bins are laid out over the centroids, the boxes themselves can overlap a lot
+		Vector3 centroidMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 centroidMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t itemIdx{ firstItem }; itemIdx < firstItem + nrItems; ++itemIdx)
+		{
+			const Vector3 centroid{ GetCentroid(m_Items[itemIdx]) };
+			centroidMin = Min(centroidMin, centroid);
+			centroidMax = Max(centroidMax, centroid);
+		}
+
+		const Vector3 centroidSize{ centroidMax - centroidMin };
+		int axis{ centroidSize.x >= centroidSize.y ? 0 : 1 };
+		if (centroidSize.z > centroidSize[axis])
+		{
+			axis = 2;
+		}
+		const float extent{ centroidSize[axis] };
+
+		uint32_t nrLeftItems{};
+		if (extent <= 0.f)
+		{
+			//Every centroid is in the same place, no plane separates them
+			if (nrItems <= MaxLeafItems)
+				return;
+
+			nrLeftItems = nrItems / 2;
+		}
+		else
+		{
+			struct Bin
+			{
+				Vector3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+				Vector3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				uint32_t nrItems{};
+			};
+
+			const float binScale{ NrBins / extent };
+			const float axisMin{ centroidMin[axis] };
+			const auto getBinIdx = [binScale, axisMin, axis](const Item& item)
+				{
+					return std::min(NrBins - 1, static_cast<int>((GetCentroid(item)[axis] - axisMin) * binScale));
+				};
+
+			Bin bins[NrBins]{};
+			for (uint32_t itemIdx{ firstItem }; itemIdx < firstItem + nrItems; ++itemIdx)
+			{
+				const Item& item{ m_Items[itemIdx] };
+				Bin& bin{ bins[getBinIdx(item)] };
+				bin.boundsMin = Min(bin.boundsMin, item.boundsMin);
+				bin.boundsMax = Max(bin.boundsMax, item.boundsMax);
+				++bin.nrItems;
+			}
+
+			//Area times item count of everything left of plane i (between bin i and i + 1), then the same from the right
+			float leftCosts[NrBins - 1]{};
+			uint32_t leftCounts[NrBins - 1]{};
+			Bin left{};
+			for (int plane{}; plane < NrBins - 1; ++plane)
+			{
+				left.boundsMin = Min(left.boundsMin, bins[plane].boundsMin);
+				left.boundsMax = Max(left.boundsMax, bins[plane].boundsMax);
+				left.nrItems += bins[plane].nrItems;
+				leftCounts[plane] = left.nrItems;
+				leftCosts[plane] = left.nrItems > 0 ? GetArea(left.boundsMin, left.boundsMax) * left.nrItems : 0.f;
+			}
+
+			int bestPlane{ -1 };
+			float bestCost{ FLT_MAX };
+			Bin right{};
+			for (int plane{ NrBins - 2 }; plane >= 0; --plane)
+			{
+				right.boundsMin = Min(right.boundsMin, bins[plane + 1].boundsMin);
+				right.boundsMax = Max(right.boundsMax, bins[plane + 1].boundsMax);
+				right.nrItems += bins[plane + 1].nrItems;
+				if (leftCounts[plane] == 0 || right.nrItems == 0)
+					continue;
+
+				const float cost{ leftCosts[plane] + GetArea(right.boundsMin, right.boundsMax) * right.nrItems };
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestPlane = plane;
+				}
+			}
+
+			//Times the area of the node: testing every item of a leaf against visiting the node and the items of both children
+			const Node& node{ m_Nodes[nodeIdx] };
+			const float nodeArea{ GetArea(node.boundsMin, node.boundsMax) };
+			if (nrItems <= MaxLeafItems && nrItems * nodeArea <= TraversalCost * nodeArea + bestCost)
+				return;
+
+			const auto middle{ std::partition(m_Items.begin() + firstItem, m_Items.begin() + firstItem + nrItems,
+				[&getBinIdx, bestPlane](const Item& item) { return getBinIdx(item) <= bestPlane; }) };
+			nrLeftItems = static_cast<uint32_t>(middle - (m_Items.begin() + firstItem));
+		}
+
+		const uint32_t leftChild{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes[nodeIdx].leftChild = leftChild;
+
+		Node child{};
+		child.parent = nodeIdx;
+		child.firstItem = firstItem;
+		child.nrItems = nrLeftItems;
+		m_Nodes.push_back(child);
+		child.firstItem = firstItem + nrLeftItems;
+		child.nrItems = nrItems - nrLeftItems;
+		m_Nodes.push_back(child);
+
+		UpdateNodeBounds(leftChild);
+		UpdateNodeBounds(leftChild + 1);
+		Subdivide(leftChild);
+		Subdivide(leftChild + 1);
+	}
+
+	void SceneBVH::UpdateNodeBounds(uint32_t nodeIdx)
+	{
+		Node& node{ m_Nodes[nodeIdx] };
+		if (node.leftChild != NoNode)
+		{
+			const Node& left{ m_Nodes[node.leftChild] };
+			const Node& right{ m_Nodes[node.leftChild + 1] };
+			node.boundsMin = Min(left.boundsMin, right.boundsMin);
+			node.boundsMax = Max(left.boundsMax, right.boundsMax);
+			return;
+		}
+
+		node.boundsMin = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		node.boundsMax = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t itemIdx{ node.firstItem }; itemIdx < node.firstItem + node.nrItems; ++itemIdx)
+		{
+			node.boundsMin = Min(node.boundsMin, m_Items[itemIdx].boundsMin);
+			node.boundsMax = Max(node.boundsMax, m_Items[itemIdx].boundsMax);
+		}
+	}
+
+	void SceneBVH::SetBounds(uint32_t id, const Vector3& boundsMin, const Vector3& boundsMax)
+	{
+		if (id >= m_ItemPositions.size() || m_ItemPositions[id] == NoNode)
+			return;
+
+		const uint32_t position{ m_ItemPositions[id] };
+		m_Items[position].boundsMin = boundsMin;
+		m_Items[position].boundsMax = boundsMax;
+
+		//A dirty node already has its whole path to the root dirty
+		for (uint32_t nodeIdx{ m_ItemLeaves[position] }; nodeIdx != NoNode && !m_Nodes[nodeIdx].isDirty; nodeIdx = m_Nodes[nodeIdx].parent)
+		{
+			m_Nodes[nodeIdx].isDirty = true;
+			++m_NrDirtyNodes;
+		}
+	}
+
+	void SceneBVH::Refit()
+	{
+		if (m_NrDirtyNodes == 0)
+			return;
+
+		//Walking the whole array in order is faster than jumping through most of it when a large part of the scene moved
+		if (m_NrDirtyNodes * 4 > m_Nodes.size())
+		{
+			for (uint32_t nodeIdx{ static_cast<uint32_t>(m_Nodes.size()) }; nodeIdx-- > 0;)
+			{
+				UpdateNodeBounds(nodeIdx);
+				m_Nodes[nodeIdx].isDirty = false;
+			}
+		}
+		else
+		{
+			RefitNode(0);
+		}
+		m_NrDirtyNodes = 0;
+	}
+
+	void SceneBVH::RefitNode(uint32_t nodeIdx)
+	{
+		const uint32_t leftChild{ m_Nodes[nodeIdx].leftChild };
+		if (leftChild != NoNode)
+		{
+			for (uint32_t childIdx{ leftChild }; childIdx <= leftChild + 1; ++childIdx)
+			{
+				if (m_Nodes[childIdx].isDirty)
+					RefitNode(childIdx);
+			}
+		}
+		UpdateNodeBounds(nodeIdx);
+		m_Nodes[nodeIdx].isDirty = false;
+	}
+
+	void SceneBVH::Cull(const Frustum& frustum, std::vector<uint32_t>& visibleIds) const
+	{
+		visibleIds.clear();
+		if (m_Nodes.empty())
+			return;
+
+		//Bit i set means the node isn't known to be in front of plane i yet
+		constexpr uint8_t AllPlanes{ (1 << Frustum::NrPlanes) - 1 };
+		struct Entry
+		{
+			uint32_t nodeIdx;
+			uint8_t planeMask;
+		};
+
+		std::vector<Entry> stack{};
+		stack.reserve(64);
+		stack.push_back(Entry{ 0, AllPlanes });
+		while (!stack.empty())
+		{
+			const Entry entry{ stack.back() };
+			stack.pop_back();
+
+			const Node& node{ m_Nodes[entry.nodeIdx] };
+			uint8_t planeMask{ entry.planeMask };
+			bool isOutside{};
+			for (int planeIdx{}; planeIdx < Frustum::NrPlanes && !isOutside; ++planeIdx)
+			{
+				if ((planeMask & (1 << planeIdx)) == 0)
+					continue;
+
+				const Plane& plane{ frustum.planes[planeIdx] };
+				if (plane.GetMaxSignedDistance(node.boundsMin, node.boundsMax) < 0.f)
+				{
+					isOutside = true;
+				}
+				else if (plane.GetMinSignedDistance(node.boundsMin, node.boundsMax) >= 0.f)
+				{
+					planeMask &= ~(1 << planeIdx);
+				}
+			}
+			if (isOutside)
+				continue;
+
+			if (planeMask == 0)
+			{
+				for (uint32_t itemIdx{ node.firstItem }; itemIdx < node.firstItem + node.nrItems; ++itemIdx)
+				{
+					visibleIds.push_back(m_Items[itemIdx].id);
+				}
+				continue;
+			}
+
+			if (node.leftChild != NoNode)
+			{
+				stack.push_back(Entry{ node.leftChild + 1, planeMask });
+				stack.push_back(Entry{ node.leftChild, planeMask });
+				continue;
+			}
+
+			for (uint32_t itemIdx{ node.firstItem }; itemIdx < node.firstItem + node.nrItems; ++itemIdx)
+			{
+				const Item& item{ m_Items[itemIdx] };
+				bool isItemOutside{};
+				for (int planeIdx{}; planeIdx < Frustum::NrPlanes && !isItemOutside; ++planeIdx)
+				{
+					isItemOutside = (planeMask & (1 << planeIdx)) != 0 && frustum.planes[planeIdx].GetMaxSignedDistance(item.boundsMin, item.boundsMax) < 0.f;
+				}
+				if (!isItemOutside)
+				{
+					visibleIds.push_back(item.id);
+				}
+			}
+		}
+	}
+
+	float SceneBVH::GetSAHCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.f;
+
+		float cost{};
+		for (const Node& node : m_Nodes)
+		{
+			const float area{ GetArea(node.boundsMin, node.boundsMax) };
+			cost += node.leftChild != NoNode ? TraversalCost * area : node.nrItems * area;
+		}
+		return cost / GetArea(m_Nodes[0].boundsMin, m_Nodes[0].boundsMax);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <vector>
+
+//Project includes
+#include "Frustum.h"
+#include "Math.h"
+
+namespace dae
+{
+	//Bounding volume hierarchy over the world space boxes of the meshes in a scene, so culling only visits the nodes near the frustum
+	//Items are ids the caller picks (indices into its mesh vector), the hierarchy only knows their boxes
+	class SceneBVH final
+	{
+	public:
+		struct Item
+		{
+			uint32_t id{};
+			Vector3 boundsMin{};
+			Vector3 boundsMax{};
+		};
+
+		//Leaves hold at most this many items, the SAH makes them smaller when that's cheaper
+		static constexpr uint32_t MaxLeafItems{ 4 };
+
+		SceneBVH() = default;
+
+		//Binned surface area heuristic build (Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies")
+		//Ids have to be unique, they don't have to be dense
+		void Build(const std::vector<Item>& items);
+
+		//New world space box of an item that moved, the nodes above it are only updated by the next Refit
+		//Ids that aren't in the hierarchy are ignored
+		void SetBounds(uint32_t id, const Vector3& boundsMin, const Vector3& boundsMax);
+		//Grows or shrinks the nodes above the items SetBounds changed, the tree itself stays the same
+		//Only the changed paths are visited, unless so many items moved that refitting every node is cheaper
+		void Refit();
+
+		//Ids of the items whose own box isn't completely behind one frustum plane, the same ones Frustum::IsOutside keeps
+		//Nodes completely in front of a plane don't test it again below, nodes completely inside add their items without any test
+		void Cull(const Frustum& frustum, std::vector<uint32_t>& visibleIds) const;
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		size_t GetItemCount() const { return m_Items.size(); }
+		size_t GetNodeCount() const { return m_Nodes.size(); }
+		//Sum of the surface areas of the nodes relative to the root, what the SAH minimizes, lower is better
+		float GetSAHCost() const;
+
+	private:
+		static constexpr uint32_t NoNode{ UINT32_MAX };
+		//Buckets the centroids are sorted into along the split axis
+		static constexpr int NrBins{ 16 };
+		//Cost of visiting a node relative to testing an item
+		static constexpr float TraversalCost{ 1.f };
+
+		struct Node
+		{
+			Vector3 boundsMin{};
+			Vector3 boundsMax{};
+			//Children are at leftChild and leftChild + 1, NoNode for leaves
+			uint32_t leftChild{ NoNode };
+			uint32_t parent{ NoNode };
+			//Items of the whole subtree, contiguous in m_Items
+			uint32_t firstItem{};
+			uint32_t nrItems{};
+			//Set while a Refit is pending for the node
+			bool isDirty{};
+		};
+
+		//Parents come before their children, so refitting in reverse node order is bottom-up
+		std::vector<Node> m_Nodes{};
+		//In tree order
+		std::vector<Item> m_Items{};
+		//Leaf node of every entry of m_Items
+		std::vector<uint32_t> m_ItemLeaves{};
+		//Position in m_Items of every id, indexed by id
+		std::vector<uint32_t> m_ItemPositions{};
+		//Nodes that need their bounds recalculated by Refit, the dirty ones always include the root and form one subtree
+		size_t m_NrDirtyNodes{};
+
+		//Splits the node with the cheapest bin plane along the longest centroid axis, or leaves it a leaf
+		void Subdivide(uint32_t nodeIdx);
+		//Bounds of the items of a leaf or of the two children
+		void UpdateNodeBounds(uint32_t nodeIdx);
+		//Dirty children first, clean subtrees are skipped
+		void RefitNode(uint32_t nodeIdx);
+	};
+}
@@ -1,48 +1,680 @@
 #include "Texture.h"
-#include "Vector2.h"
 #include <SDL_image.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "BlockCompression.h"
+#include "CpuFeatures.h"
+#include "SamplerAVX2.h"
+
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	//The DirectDraw Surface header that follows the "DDS " magic, only the fields needed for 2D block compressed textures are used
+	struct DDSPixelFormat
+	{
+		uint32_t size{};
+		uint32_t flags{};
+		uint32_t fourCC{};
+		uint32_t rgbBitCount{};
+		uint32_t bitMasks[4]{};
+	};
+
+	struct DDSHeader
+	{
+		uint32_t size{};
+		uint32_t flags{};
+		uint32_t height{};
+		uint32_t width{};
+		uint32_t pitchOrLinearSize{};
+		uint32_t depth{};
+		uint32_t mipMapCount{};
+		uint32_t reserved1[11]{};
+		DDSPixelFormat pixelFormat{};
+		uint32_t caps{};
+		uint32_t caps2{};
+		uint32_t caps3{};
+		uint32_t caps4{};
+		uint32_t reserved2{};
+	};
+
+	//Follows DDSHeader when its fourCC is "DX10"
+	struct DDSHeaderDX10
+	{
+		uint32_t dxgiFormat{};
+		uint32_t resourceDimension{};
+		uint32_t miscFlag{};
+		uint32_t arraySize{};
+		uint32_t miscFlags2{};
+	};
+
+	static_assert(sizeof(DDSHeader) == 124 && sizeof(DDSHeaderDX10) == 20, "DDS headers are read and written as is");
+
+	static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+	}
+
+	static constexpr uint32_t DDSMagic{ MakeFourCC('D', 'D', 'S', ' ') };
+	static constexpr uint32_t DDSD_CAPS{ 0x1 }, DDSD_HEIGHT{ 0x2 }, DDSD_WIDTH{ 0x4 }, DDSD_PIXELFORMAT{ 0x1000 }, DDSD_MIPMAPCOUNT{ 0x20000 }, DDSD_LINEARSIZE{ 0x80000 };
+	static constexpr uint32_t DDPF_FOURCC{ 0x4 };
+	static constexpr uint32_t DDSCAPS_COMPLEX{ 0x8 }, DDSCAPS_TEXTURE{ 0x1000 }, DDSCAPS_MIPMAP{ 0x400000 };
+	static constexpr uint32_t DDSCAPS2_CUBEMAP{ 0x200 }, DDSCAPS2_VOLUME{ 0x200000 };
+	static constexpr uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D{ 3 };
+
+	//Returns false for anything that isn't BC1, BC3 or unsigned BC5
+	static bool GetDDSFormat(uint32_t fourCC, const DDSHeaderDX10& headerDX10, TextureFormat& format)
+	{
+		if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			switch (headerDX10.dxgiFormat)
+			{
+			case 70: case 71: case 72: //DXGI_FORMAT_BC1_TYPELESS, _UNORM, _UNORM_SRGB
+				format = TextureFormat::BC1;
+				return true;
+			case 76: case 77: case 78: //DXGI_FORMAT_BC3_TYPELESS, _UNORM, _UNORM_SRGB
+				format = TextureFormat::BC3;
+				return true;
+			case 82: case 83: //DXGI_FORMAT_BC5_TYPELESS, _UNORM
+				format = TextureFormat::BC5;
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+			format = TextureFormat::BC1;
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '5'))
+			format = TextureFormat::BC3;
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U'))
+			format = TextureFormat::BC5;
+		else
+			return false;
+
+		return true;
+	}
+
+	static bool HasExtension(const std::string& path, const std::string& extension)
+	{
+		if (path.size() < extension.size())
+			return false;
+
+		return std::equal(extension.begin(), extension.end(), path.end() - extension.size(), [](char a, char b)
+			{
+				return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+			});
+	}
+
+	Texture::Texture(SDL_Surface* pSurface, TextureLayout layout, TextureFormat format) :
+		m_Width{ pSurface->w },
+		m_Height{ pSurface->h },
+		m_Layout{ format == TextureFormat::RGBA8 ? layout : TextureLayout::Linear },
+		m_Format{ format },
+		m_Id{ GetNextId() }
 	{
+		//Room for the full mip chain, about a third on top of the image itself
+		size_t nrTexels{};
+		for (int width{ m_Width }, height{ m_Height }; ; width = std::max(width / 2, 1), height = std::max(height / 2, 1))
+		{
+			nrTexels += static_cast<size_t>(width) * height;
+			if (width == 1 && height == 1)
+				break;
+		}
+		m_pTexels = new uint32_t[nrTexels];
+
+		//Rows of the surface can be padded
+		for (int y{}; y < m_Height; ++y)
+		{
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch };
+			std::memcpy(m_pTexels + y * m_Width, pRow, m_Width * sizeof(uint32_t));
+		}
+
+		GenerateMipLevels();
+		if (m_Format == TextureFormat::RGBA8)
+			ApplyLayout();
+		else
+			Compress();
+	}
+
+	Texture::Texture(TextureFormat format, int width, int height, int nrLevels) :
+		m_Width{ width },
+		m_Height{ height },
+		m_Format{ format },
+		m_Id{ GetNextId() }
+	{
+		size_t nrBytes{};
+		for (int levelIdx{}, levelWidth{ width }, levelHeight{ height }; levelIdx < nrLevels; ++levelIdx, levelWidth = std::max(levelWidth / 2, 1), levelHeight = std::max(levelHeight / 2, 1))
+		{
+			nrBytes += GetLevelBlockBytes(format, levelWidth, levelHeight);
+		}
+		m_pBlocks = new uint8_t[nrBytes]{};
+
+		const uint8_t* pLevelBlocks{ m_pBlocks };
+		for (int levelIdx{}, levelWidth{ width }, levelHeight{ height }; levelIdx < nrLevels; ++levelIdx, levelWidth = std::max(levelWidth / 2, 1), levelHeight = std::max(levelHeight / 2, 1))
+		{
+			m_MipLevels.push_back(MipLevel{ nullptr, levelWidth, levelHeight, (levelWidth + 3) / 4, pLevelBlocks });
+			pLevelBlocks += GetLevelBlockBytes(format, levelWidth, levelHeight);
+		}
 	}
 
 	Texture::~Texture()
 	{
-		if (m_pSurface)
+		delete[] m_pTexels;
+		delete[] m_pBlocks;
+	}
+
+	Texture* Texture::LoadFromFile(const std::string& path, TextureLayout layout, TextureFormat format)
+	{
+		if (HasExtension(path, ".dds"))
+			return LoadFromDDS(path);
+
+		SDL_Surface* pSurface{ IMG_Load(path.c_str()) };
+		if (!pSurface)
+			return nullptr;
+
+		//Whatever the file holds, decode it to one known layout so sampling never needs the SDL_PixelFormat
+		//ABGR8888 is a packed format, so r is in the lowest byte on any endianness
+		SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ABGR8888, 0) };
+		SDL_FreeSurface(pSurface);
+		if (!pConverted)
+			return nullptr;
+
+		Texture* pTexture{ new Texture{ pConverted, layout, format } };
+		SDL_FreeSurface(pConverted);
+
+		return pTexture;
+	}
+
+	Texture* Texture::LoadFromDDS(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+			return nullptr;
+
+		uint32_t magic{};
+		DDSHeader header{};
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || magic != DDSMagic || header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & DDPF_FOURCC))
+			return nullptr;
+
+		DDSHeaderDX10 headerDX10{ 0, D3D10_RESOURCE_DIMENSION_TEXTURE2D, 0, 1 };
+		if (header.pixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0'))
+			file.read(reinterpret_cast<char*>(&headerDX10), sizeof(headerDX10));
+
+		//Only single 2D textures, no cube maps, volumes or arrays
+		TextureFormat format{};
+		if (!file || !GetDDSFormat(header.pixelFormat.fourCC, headerDX10, format)
+			|| (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) || headerDX10.resourceDimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || headerDX10.arraySize != 1
+			|| header.width == 0 || header.height == 0 || header.width > 0xFFFF || header.height > 0xFFFF)
+			return nullptr;
+
+		//A partial chain is fine, GetLod never goes past the last level
+		int nrLevels{ 1 };
+		for (uint32_t size{ std::max(header.width, header.height) }; size > 1; size /= 2)
+		{
+			++nrLevels;
+		}
+		//Some writers leave DDSD_MIPMAPCOUNT out, a count of 0 means there is only the image itself
+		nrLevels = std::clamp(static_cast<int>(std::min(header.mipMapCount, 32u)), 1, nrLevels);
+
+		Texture* pTexture{ new Texture{ format, static_cast<int>(header.width), static_cast<int>(header.height), nrLevels } };
+		file.read(reinterpret_cast<char*>(pTexture->m_pBlocks), pTexture->GetMemorySize());
+		if (!file)
+		{
+			delete pTexture;
+			return nullptr;
+		}
+
+		return pTexture;
+	}
+
+	bool Texture::SaveToDDS(const std::string& path) const
+	{
+		if (m_Format == TextureFormat::RGBA8)
+			return false;
+
+		DDSHeader header{};
+		header.size = sizeof(DDSHeader);
+		header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+		header.height = static_cast<uint32_t>(m_Height);
+		header.width = static_cast<uint32_t>(m_Width);
+		header.pitchOrLinearSize = static_cast<uint32_t>(GetLevelBlockBytes(m_Format, m_Width, m_Height));
+		header.mipMapCount = static_cast<uint32_t>(m_MipLevels.size());
+		header.pixelFormat.size = sizeof(DDSPixelFormat);
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.caps = DDSCAPS_TEXTURE | (m_MipLevels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+		switch (m_Format)
+		{
+		case TextureFormat::BC1:
+			header.pixelFormat.fourCC = MakeFourCC('D', 'X', 'T', '1');
+			break;
+		case TextureFormat::BC3:
+			header.pixelFormat.fourCC = MakeFourCC('D', 'X', 'T', '5');
+			break;
+		default:
+			header.pixelFormat.fourCC = MakeFourCC('A', 'T', 'I', '2');
+			break;
+		}
+
+		std::ofstream file{ path, std::ios::binary };
+		file.write(reinterpret_cast<const char*>(&DDSMagic), sizeof(DDSMagic));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(m_pBlocks), GetMemorySize());
+
+		return static_cast<bool>(file);
+	}
+
+	size_t Texture::GetMemorySize() const
+	{
+		size_t nrBytes{};
+		for (const MipLevel& level : m_MipLevels)
+		{
+			nrBytes += m_Format == TextureFormat::RGBA8 ? GetLevelSize(level.width, level.height) * sizeof(uint32_t) : GetLevelBlockBytes(m_Format, level.width, level.height);
+		}
+		return nrBytes;
+	}
+
+	uint64_t Texture::GetNextId()
+	{
+		static std::atomic<uint64_t> nextId{};
+		return nextId++;
+	}
+
+	void Texture::GenerateMipLevels()
+	{
+		m_MipLevels.push_back(MipLevel{ m_pTexels, m_Width, m_Height });
+
+		while (m_MipLevels.back().width > 1 || m_MipLevels.back().height > 1)
+		{
+			const MipLevel& source{ m_MipLevels.back() };
+			MipLevel level{ source.pTexels + source.width * source.height, std::max(source.width / 2, 1), std::max(source.height / 2, 1) };
+
+			for (int y{}; y < level.height; ++y)
+			{
+				//Odd sizes drop their last row/column, a level that is already 1 wide reuses it
+				const int y0{ std::min(y * 2, source.height - 1) };
+				const int y1{ std::min(y * 2 + 1, source.height - 1) };
+
+				for (int x{}; x < level.width; ++x)
+				{
+					const int x0{ std::min(x * 2, source.width - 1) };
+					const int x1{ std::min(x * 2 + 1, source.width - 1) };
+
+					const uint32_t texels[4]
+					{
+						source.pTexels[x0 + y0 * source.width], source.pTexels[x1 + y0 * source.width],
+						source.pTexels[x0 + y1 * source.width], source.pTexels[x1 + y1 * source.width]
+					};
+
+					//Average every byte, rounded
+					uint32_t result{};
+					for (int shift{}; shift < 32; shift += 8)
+					{
+						uint32_t sum{ 2 };
+						for (const uint32_t texel : texels)
+						{
+							sum += (texel >> shift) & 0xFF;
+						}
+						result |= (sum / 4) << shift;
+					}
+					level.pTexels[x + y * level.width] = result;
+				}
+			}
+
+			m_MipLevels.push_back(level);
+		}
+	}
+
+	size_t Texture::GetLevelSize(int width, int height) const
+	{
+		return GetLevelSize(m_Layout, width, height);
+	}
+
+	size_t Texture::GetLevelSize(TextureLayout layout, int width, int height)
+	{
+		switch (layout)
+		{
+		case TextureLayout::Tiled4x4:
+			return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 16;
+		case TextureLayout::Tiled8x8:
+			return static_cast<size_t>((width + 7) / 8) * ((height + 7) / 8) * 64;
+		case TextureLayout::Morton:
+			//Highest index plus one, only dense when both sides are powers of two at most a factor 2 apart
+			return (SpreadBits(static_cast<uint32_t>(width - 1)) | (SpreadBits(static_cast<uint32_t>(height - 1)) << 1)) + 1;
+		default:
+			return static_cast<size_t>(width) * height;
+		}
+	}
+
+	void Texture::ApplyLayout()
+	{
+		if (m_Layout == TextureLayout::Linear)
+			return;
+
+		//Morton indices are only 16 bits per axis
+		if (m_Layout == TextureLayout::Morton && std::max(m_Width, m_Height) > 0xFFFF)
+		{
+			m_Layout = TextureLayout::Linear;
+			return;
+		}
+
+		size_t nrTexels{};
+		for (const MipLevel& level : m_MipLevels)
+		{
+			nrTexels += GetLevelSize(level.width, level.height);
+		}
+
+		//Padding texels stay zero, nothing samples them
+		uint32_t* pTexels{ new uint32_t[nrTexels]{} };
+		uint32_t* pLevelTexels{ pTexels };
+		for (MipLevel& level : m_MipLevels)
+		{
+			MipLevel swizzled{ pLevelTexels, level.width, level.height, 0 };
+			if (m_Layout == TextureLayout::Tiled4x4)
+				swizzled.nrTilesX = (level.width + 3) / 4;
+			else if (m_Layout == TextureLayout::Tiled8x8)
+				swizzled.nrTilesX = (level.width + 7) / 8;
+
+			for (int y{}; y < level.height; ++y)
+			{
+				for (int x{}; x < level.width; ++x)
+				{
+					pLevelTexels[GetTexelIndex(swizzled, x, y)] = level.pTexels[x + y * level.width];
+				}
+			}
+
+			pLevelTexels += GetLevelSize(level.width, level.height);
+			level = swizzled;
+		}
+
+		delete[] m_pTexels;
+		m_pTexels = pTexels;
+	}
+
+	int Texture::GetBlockBytes(TextureFormat format)
+	{
+		switch (format)
+		{
+		case TextureFormat::BC1:
+			return BlockCompression::BC1BlockBytes;
+		case TextureFormat::BC3:
+			return BlockCompression::BC3BlockBytes;
+		case TextureFormat::BC5:
+			return BlockCompression::BC5BlockBytes;
+		default:
+			return 0;
+		}
+	}
+
+	size_t Texture::GetLevelBlockBytes(TextureFormat format, int width, int height)
+	{
+		return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+	}
+
+	void Texture::Compress()
+	{
+		size_t nrBytes{};
+		for (const MipLevel& level : m_MipLevels)
+		{
+			nrBytes += GetLevelBlockBytes(m_Format, level.width, level.height);
+		}
+		m_pBlocks = new uint8_t[nrBytes];
+
+		uint8_t* pBlock{ m_pBlocks };
+		for (MipLevel& level : m_MipLevels)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			level.nrTilesX = (level.width + 3) / 4;
+			level.pBlocks = pBlock;
+
+			for (int by{}; by < (level.height + 3) / 4; ++by)
+			{
+				for (int bx{}; bx < level.nrTilesX; ++bx)
+				{
+					//Blocks past the edge repeat the last row/column, nothing samples those texels
+					uint32_t texels[BlockCompression::TexelsPerBlock]{};
+					for (int idx{}; idx < BlockCompression::TexelsPerBlock; ++idx)
+					{
+						const int x{ std::min(bx * 4 + idx % 4, level.width - 1) };
+						const int y{ std::min(by * 4 + idx / 4, level.height - 1) };
+						texels[idx] = level.pTexels[x + y * level.width];
+					}
+
+					switch (m_Format)
+					{
+					case TextureFormat::BC1:
+						BlockCompression::EncodeBC1(texels, pBlock);
+						break;
+					case TextureFormat::BC3:
+						BlockCompression::EncodeBC3(texels, pBlock);
+						break;
+					default:
+						BlockCompression::EncodeBC5(texels, pBlock);
+						break;
+					}
+					pBlock += GetBlockBytes(m_Format);
+				}
+			}
+
+			level.pTexels = nullptr;
 		}
+
+		delete[] m_pTexels;
+		m_pTexels = nullptr;
+	}
+
+	uint32_t Texture::FetchBlockTexel(const MipLevel& level, int x, int y) const
+	{
+		//Enough for the 2x2 blocks of a bilinear footprint in two levels, for a few textures at once
+		thread_local BlockCompression::DecodedBlockCache<uint32_t, 64> cache{};
+
+		const int blockBytes{ GetBlockBytes(m_Format) };
+		const uint8_t* pBlock{ level.pBlocks + (static_cast<size_t>(y >> 2) * level.nrTilesX + (x >> 2)) * blockBytes };
+		const uint64_t key{ (m_Id << 40) | static_cast<uint64_t>((pBlock - m_pBlocks) / blockBytes) };
+
+		const uint32_t* pTexels{ cache.Get(key, [this, pBlock](uint32_t (&texels)[BlockCompression::TexelsPerBlock])
+			{
+				switch (m_Format)
+				{
+				case TextureFormat::BC1:
+					BlockCompression::DecodeBC1(pBlock, texels);
+					break;
+				case TextureFormat::BC3:
+					BlockCompression::DecodeBC3(pBlock, texels);
+					break;
+				default:
+					BlockCompression::DecodeBC5(pBlock, texels);
+					break;
+				}
+			}) };
+
+		return pTexels[((y & 3) << 2) + (x & 3)];
+	}
+
+	float Texture::GetLod(const Vector2& uvDx, const Vector2& uvDy) const
+	{
+		return GetLod(uvDx, uvDy, m_Width, m_Height, m_MipLevels.size());
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	float Texture::GetLod(const Vector2& uvDx, const Vector2& uvDy, int width, int height, size_t nrLevels)
 	{
-		//TODO
-		//Load SDL_Surface using IMG_LOAD
-		//Create & Return a new Texture Object (using SDL_Surface)
-		SDL_Surface* surface = IMG_Load(path.c_str());
-		Texture* texture{ new Texture{surface} };
+		//Texels the footprint of one pixel covers along its longest axis
+		const Vector2 texelDx{ uvDx.x * width, uvDx.y * height };
+		const Vector2 texelDy{ uvDy.x * width, uvDy.y * height };
+		const float maxSqrLength{ std::max(texelDx.SqrMagnitude(), texelDy.SqrMagnitude()) };
 
-		return texture;
+		//log2(sqrt(x)) = log2(x) / 2
+		const float lod{ 0.5f * std::log2(std::max(maxSqrLength, 1e-12f)) };
+		return std::clamp(lod, 0.f, static_cast<float>(nrLevels - 1));
+	}
+
+	bool Texture::GetBatchLevels(const float* pLods, int count, TextureFilter filter, size_t& level, float* pWeights)
+	{
+		//Trilinear blends towards the next level with a weight per uv, bilinear only reads the closest one
+		const bool isTrilinear{ filter == TextureFilter::Trilinear };
+		const auto getLevel{ [isTrilinear](float lod) { return static_cast<size_t>(isTrilinear ? lod : lod + 0.5f); } };
+
+		level = getLevel(pLods[0]);
+		for (int idx{}; idx < count; ++idx)
+		{
+			if (getLevel(pLods[idx]) != level)
+				return false;
+
+			pWeights[idx] = isTrilinear ? pLods[idx] - static_cast<float>(level) : 0.f;
+		}
+
+		return true;
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		//TODO
-		//Sample the correct texel for the given uv
-		const int nrColors{ 3 };
-		Uint8 rgb[nrColors];
-		//px + (py * m_Width)
-		int idx{ static_cast<int>(uv.x * m_pSurface->w) + (static_cast<int>(uv.y * m_pSurface->h) * m_pSurface->w) };
+		return SampleNearest(m_MipLevels.front(), uv, TextureAddress::Clamp);
+	}
+
+	ColorRGB Texture::Sample(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address) const
+	{
+		if (filter == TextureFilter::Nearest)
+			return SampleNearest(m_MipLevels.front(), uv, address);
+
+		const float lod{ GetLod(uvDx, uvDy) };
+
+		switch (filter)
+		{
+		case TextureFilter::NearestMip:
+			return SampleNearest(m_MipLevels[static_cast<size_t>(lod + 0.5f)], uv, address);
+		case TextureFilter::Bilinear:
+			return SampleBilinear(m_MipLevels[static_cast<size_t>(lod + 0.5f)], uv, address);
+		default:
+		{
+			const size_t level{ static_cast<size_t>(lod) };
+			const float weight{ lod - static_cast<float>(level) };
+
+			const ColorRGB color{ SampleBilinear(m_MipLevels[level], uv, address) };
+			if (weight == 0.f)
+				return color;
+
+			return ColorRGB::Lerp(color, SampleBilinear(m_MipLevels[level + 1], uv, address), weight);
+		}
+		}
+	}
+
+	void Texture::SampleBatch(const Vector2* pUVs, const Vector2* pUVDx, const Vector2* pUVDy, int count, TextureFilter filter, TextureAddress address, ColorRGB* pColors) const
+	{
+		const bool isFiltered{ filter == TextureFilter::Bilinear || filter == TextureFilter::Trilinear };
+		if (isFiltered && count > 1 && m_Format == TextureFormat::RGBA8 && CpuFeatures::HasAVX2())
+		{
+			float lods[SampleBatchSize]{};
+			for (int idx{}; idx < count; ++idx)
+			{
+				lods[idx] = GetLod(pUVDx[idx], pUVDy[idx]);
+			}
+
+			size_t level{};
+			float weights[SampleBatchSize]{};
+			if (GetBatchLevels(lods, count, filter, level, weights))
+			{
+				SampleBatch_AVX2(pUVs, count, level, filter == TextureFilter::Trilinear ? weights : nullptr, address, pColors);
+				return;
+			}
+		}
 
-		Uint32 pixel{ m_pSurfacePixels[idx] };
-		SDL_GetRGB(pixel, m_pSurface->format, &rgb[0], &rgb[1], &rgb[2]);
+		for (int idx{}; idx < count; ++idx)
+		{
+			pColors[idx] = Sample(pUVs[idx], pUVDx[idx], pUVDy[idx], filter, address);
+		}
+	}
+
+	void Texture::SampleBatch_AVX2(const Vector2* pUVs, int count, size_t level, const float* pWeights, TextureAddress address, ColorRGB* pColors) const
+	{
+		//Lanes past count repeat the first uv, their results are dropped
+		alignas(32) float us[SampleBatchSize]{};
+		alignas(32) float vs[SampleBatchSize]{};
+		alignas(32) float weights[SampleBatchSize]{};
+		for (int lane{}; lane < SampleBatchSize; ++lane)
+		{
+			const int idx{ lane < count ? lane : 0 };
+			us[lane] = pUVs[idx].x;
+			vs[lane] = pUVs[idx].y;
+			weights[lane] = pWeights ? pWeights[idx] : 0.f;
+		}
+
+		const __m256 u{ _mm256_load_ps(us) };
+		const __m256 v{ _mm256_load_ps(vs) };
+
+		const auto sampleLevel{ [&](const MipLevel& mipLevel, __m256 (&color)[3])
+			{
+				const SamplerAVX2::Footprint footprint{ SamplerAVX2::GetFootprint(u, v, mipLevel.width, mipLevel.height, mipLevel.nrTilesX, m_Layout, address) };
+
+				__m256i corners[4]{};
+				for (int corner{}; corner < 4; ++corner)
+				{
+					corners[corner] = _mm256_i32gather_epi32(reinterpret_cast<const int*>(mipLevel.pTexels), footprint.texels[corner], 4);
+				}
+
+				color[0] = SamplerAVX2::FilterChannel<0>(corners, footprint);
+				color[1] = SamplerAVX2::FilterChannel<8>(corners, footprint);
+				color[2] = SamplerAVX2::FilterChannel<16>(corners, footprint);
+			} };
+
+		__m256 color[3]{};
+		sampleLevel(m_MipLevels[level], color);
+
+		//A weight of 0 gives back the first level exactly, like the early out of Sample
+		if (pWeights && level + 1 < m_MipLevels.size())
+		{
+			__m256 nextColor[3]{};
+			sampleLevel(m_MipLevels[level + 1], nextColor);
+
+			const __m256 weight{ _mm256_load_ps(weights) };
+			for (int channel{}; channel < 3; ++channel)
+			{
+				color[channel] = SamplerAVX2::Lerp(color[channel], nextColor[channel], weight);
+			}
+		}
+
+		alignas(32) float channels[3][SampleBatchSize]{};
+		for (int channel{}; channel < 3; ++channel)
+		{
+			_mm256_store_ps(channels[channel], color[channel]);
+		}
+
+		for (int idx{}; idx < count; ++idx)
+		{
+			pColors[idx] = ColorRGB{ channels[0][idx], channels[1][idx], channels[2][idx] };
+		}
+	}
+
+	ColorRGB Texture::SampleNearest(const MipLevel& level, const Vector2& uv, TextureAddress address) const
+	{
+		const int x{ ApplyAddress(address, static_cast<int>(std::floor(uv.x * level.width)), level.width) };
+		const int y{ ApplyAddress(address, static_cast<int>(std::floor(uv.y * level.height)), level.height) };
+
+		return Unpack(FetchTexel(level, x, y));
+	}
+
+	ColorRGB Texture::SampleBilinear(const MipLevel& level, const Vector2& uv, TextureAddress address) const
+	{
+		//Texel centers sit at half coordinates
+		const float x{ uv.x * level.width - 0.5f };
+		const float y{ uv.y * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
+		const float weightX{ x - floorX };
+		const float weightY{ y - floorY };
 
+		const int x0{ ApplyAddress(address, static_cast<int>(floorX), level.width) };
+		const int y0{ ApplyAddress(address, static_cast<int>(floorY), level.height) };
+		const int x1{ ApplyAddress(address, static_cast<int>(floorX) + 1, level.width) };
+		const int y1{ ApplyAddress(address, static_cast<int>(floorY) + 1, level.height) };
 
-		return ColorRGB{static_cast<float>(rgb[0] / 255.0f),static_cast<float>(rgb[1]/ 255.0f) ,static_cast<float>(rgb[2] / 255.0f) };
+		const ColorRGB top{ ColorRGB::Lerp(Unpack(FetchTexel(level, x0, y0)), Unpack(FetchTexel(level, x1, y0)), weightX) };
+		const ColorRGB bottom{ ColorRGB::Lerp(Unpack(FetchTexel(level, x0, y1)), Unpack(FetchTexel(level, x1, y1)), weightX) };
+		return ColorRGB::Lerp(top, bottom, weightY);
 	}
-}
\ No newline at end of file
+}
@@ -1,24 +1,220 @@
 #pragma once
-#include <SDL_surface.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "Vector2.h"
+
+struct SDL_Surface;
 
 namespace dae
 {
-	struct Vector2;
+	enum class TextureFilter
+	{
+		Nearest, //Nearest texel of the full size image, ignores the mip chain
+		NearestMip, //Nearest texel of the closest mip level
+		Bilinear, //Bilinear inside the closest mip level
+		Trilinear //Bilinear in the two closest mip levels, blended
+	};
+
+	//What happens to uvs outside [0, 1]
+	enum class TextureAddress
+	{
+		Wrap, //Repeats the texture
+		Clamp, //Repeats the edge texels
+		Mirror //Repeats the texture, flipped every other time
+	};
+
+	//Order of the texels in memory, every mip level uses the same one
+	enum class TextureLayout
+	{
+		Linear, //Row by row, like the image
+		Tiled4x4, //4x4 tiles row by row, the texels inside a tile row by row
+		Tiled8x8, //Same with 8x8 tiles, one tile is 4 cache lines
+		Morton //Z-order over the whole level, the bits of x and y interleaved
+	};
+
+	//How the texels are stored, the block compressed formats always use their own 4x4 block order
+	enum class TextureFormat
+	{
+		RGBA8, //4 bytes per texel
+		BC1, //rgb, half a byte per texel
+		BC3, //rgba, alpha stored separately, 1 byte per texel
+		BC5 //rg of a tangent space normal, blue is reconstructed, 1 byte per texel
+	};
 
 	class Texture
 	{
+		friend class Benchmark;
+		friend class Material;
+
 	public:
 		~Texture();
 
-		static Texture* LoadFromFile(const std::string& path);
+		Texture(const Texture&) = delete;
+		Texture(Texture&&) noexcept = delete;
+		Texture& operator=(const Texture&) = delete;
+		Texture& operator=(Texture&&) noexcept = delete;
+
+		//.dds files are loaded as the block compressed format they hold, layout and format are ignored for them
+		//Anything else is decoded by SDL_image and compressed to format if that is a block compressed one
+		static Texture* LoadFromFile(const std::string& path, TextureLayout layout = TextureLayout::Linear, TextureFormat format = TextureFormat::RGBA8);
+		//Writes every mip level, only for the block compressed formats
+		bool SaveToDDS(const std::string& path) const;
+
 		ColorRGB Sample(const Vector2& uv) const;
+		//uvDx and uvDy are the screen space derivatives of uv, they select the mip level
+		ColorRGB Sample(const Vector2& uv, const Vector2& uvDx, const Vector2& uvDy, TextureFilter filter, TextureAddress address = TextureAddress::Clamp) const;
+		//Same result as Sample for count uvs, at most SampleBatchSize
+		//Bilinear and trilinear sample 8 at once on AVX2 when they all land in the same mip level
+		void SampleBatch(const Vector2* pUVs, const Vector2* pUVDx, const Vector2* pUVDy, int count, TextureFilter filter, TextureAddress address, ColorRGB* pColors) const;
+
+		TextureFormat GetFormat() const { return m_Format; }
+		//Bytes of texel data, the whole mip chain included
+		size_t GetMemorySize() const;
+
+		static constexpr int SampleBatchSize{ 8 };
 
 	private:
-		Texture(SDL_Surface* pSurface);
+		struct MipLevel
+		{
+			uint32_t* pTexels{};
+			int width{};
+			int height{};
+			//Tiles in one row for the tiled layouts, blocks in one row for the block compressed formats
+			int nrTilesX{};
+			//Instead of pTexels for the block compressed formats
+			const uint8_t* pBlocks{};
+		};
+
+		//Copies the texels out, the surface has to be SDL_PIXELFORMAT_ABGR8888 and can be freed afterwards
+		Texture(SDL_Surface* pSurface, TextureLayout layout, TextureFormat format);
+		//Room for nrLevels levels of blocks, filled in by LoadFromDDS
+		Texture(TextureFormat format, int width, int height, int nrLevels);
+
+		//Decoded once at load, tightly packed with r in the lowest byte and a in the highest
+		//All mip levels live in this one allocation, largest first
+		uint32_t* m_pTexels{ nullptr };
+		//Same for the block compressed formats, m_pTexels is nullptr then
+		uint8_t* m_pBlocks{ nullptr };
+		int m_Width{};
+		int m_Height{};
+		std::vector<MipLevel> m_MipLevels{};
+		TextureLayout m_Layout{};
+		TextureFormat m_Format{};
+		//Tells the blocks of different textures apart in the per thread decoded block cache
+		uint64_t m_Id{};
+
+		static Texture* LoadFromDDS(const std::string& path);
+
+		//Every level is the 2x2 box filtered version of the one before, down to 1x1
+		void GenerateMipLevels();
+		//Moves every level from row by row to m_Layout
+		void ApplyLayout();
+		//Texels a level takes up in m_Layout, tiled and Morton levels are padded
+		size_t GetLevelSize(int width, int height) const;
+		static size_t GetLevelSize(TextureLayout layout, int width, int height);
+		//Encodes every level to m_Format and frees the texels
+		void Compress();
+
+		static int GetBlockBytes(TextureFormat format);
+		//Bytes a level takes up in a block compressed format, partial blocks at the edges included
+		static size_t GetLevelBlockBytes(TextureFormat format, int width, int height);
+		//Unique over the lifetime of the program
+		static uint64_t GetNextId();
+
+		inline uint32_t FetchTexel(const MipLevel& level, int x, int y) const
+		{
+			if (m_Format == TextureFormat::RGBA8)
+				return level.pTexels[GetTexelIndex(level, x, y)];
+
+			return FetchBlockTexel(level, x, y);
+		}
+
+		//Decodes the 4x4 block holding the texel, or finds it in this thread's cache
+		uint32_t FetchBlockTexel(const MipLevel& level, int x, int y) const;
+
+		inline size_t GetTexelIndex(const MipLevel& level, int x, int y) const
+		{
+			return GetTexelIndex(m_Layout, level.width, level.nrTilesX, x, y);
+		}
+
+		//Also used by Material, which stores its levels in the same layouts
+		static inline size_t GetTexelIndex(TextureLayout layout, int width, int nrTilesX, int x, int y)
+		{
+			switch (layout)
+			{
+			case TextureLayout::Tiled4x4:
+				return ((static_cast<size_t>(y >> 2) * nrTilesX + (x >> 2)) << 4) + ((y & 3) << 2) + (x & 3);
+			case TextureLayout::Tiled8x8:
+				return ((static_cast<size_t>(y >> 3) * nrTilesX + (x >> 3)) << 6) + ((y & 7) << 3) + (x & 7);
+			case TextureLayout::Morton:
+				return SpreadBits(static_cast<uint32_t>(x)) | (SpreadBits(static_cast<uint32_t>(y)) << 1);
+			default:
+				return x + static_cast<size_t>(y) * width;
+			}
+		}
+
+		//Puts a zero bit between every bit of the lower 16
+		static inline size_t SpreadBits(uint32_t value)
+		{
+			value &= 0x0000FFFF;
+			value = (value | (value << 8)) & 0x00FF00FF;
+			value = (value | (value << 4)) & 0x0F0F0F0F;
+			value = (value | (value << 2)) & 0x33333333;
+			value = (value | (value << 1)) & 0x55555555;
+			return value;
+		}
+
+		//Texel coordinate inside [0, size)
+		static inline int ApplyAddress(TextureAddress address, int coord, int size)
+		{
+			switch (address)
+			{
+			case TextureAddress::Wrap:
+				coord %= size;
+				return coord < 0 ? coord + size : coord;
+			case TextureAddress::Mirror:
+			{
+				const int period{ 2 * size };
+				coord %= period;
+				if (coord < 0)
+					coord += period;
+				return coord < size ? coord : period - 1 - coord;
+			}
+			default:
+				return std::clamp(coord, 0, size - 1);
+			}
+		}
+
+		//Mip levels SampleBatch reads from, or false if the uvs don't share one
+		//pWeights gets the blend weight towards the next level, which is 0 for bilinear
+		static bool GetBatchLevels(const float* pLods, int count, TextureFilter filter, size_t& level, float* pWeights);
+
+		//Byte to [0, 1] without a division per channel
+		static constexpr std::array<float, 256> ByteToFloat = []
+			{
+				std::array<float, 256> lut{};
+				for (size_t value{}; value < lut.size(); ++value)
+				{
+					lut[value] = static_cast<float>(value) / 255.f;
+				}
+				return lut;
+			}();
+
+		static inline ColorRGB Unpack(uint32_t texel)
+		{
+			return ColorRGB{ ByteToFloat[texel & 0xFF], ByteToFloat[(texel >> 8) & 0xFF], ByteToFloat[(texel >> 16) & 0xFF] };
+		}
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		float GetLod(const Vector2& uvDx, const Vector2& uvDy) const;
+		//Mip level of a width x height image with nrLevels levels, the fraction is the blend weight towards the next one
+		static float GetLod(const Vector2& uvDx, const Vector2& uvDy, int width, int height, size_t nrLevels);
+		ColorRGB SampleNearest(const MipLevel& level, const Vector2& uv, TextureAddress address) const;
+		ColorRGB SampleBilinear(const MipLevel& level, const Vector2& uv, TextureAddress address) const;
+		//Bilinear in level, blended towards the next level with pWeights if it isn't nullptr
+		void SampleBatch_AVX2(const Vector2* pUVs, int count, size_t level, const float* pWeights, TextureAddress address, ColorRGB* pColors) const;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,89 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	ThreadPool::ThreadPool(uint32_t nrThreads)
+	{
+		//hardware_concurrency is allowed to return 0
+		nrThreads = std::max(nrThreads, 1u);
+
+		m_Workers.reserve(nrThreads - 1);
+		for (uint32_t threadIdx{ 1 }; threadIdx < nrThreads; ++threadIdx)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, threadIdx);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsShuttingDown = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t jobCount, const std::function<void(uint32_t, uint32_t)>& job)
+	{
+		if (jobCount == 0)
+			return;
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pJob = &job;
+			m_JobCount = jobCount;
+			m_NextJob = 0;
+			m_NrBusyWorkers = static_cast<uint32_t>(m_Workers.size());
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		//Calling thread helps out instead of idling
+		RunJobs(0);
+
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_NrBusyWorkers == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t threadIdx)
+	{
+		uint64_t generation{};
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [&] { return m_IsShuttingDown || m_Generation != generation; });
+
+				if (m_IsShuttingDown)
+					return;
+
+				generation = m_Generation;
+			}
+
+			RunJobs(threadIdx);
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				--m_NrBusyWorkers;
+			}
+			m_DoneCondition.notify_one();
+		}
+	}
+
+	void ThreadPool::RunJobs(uint32_t threadIdx)
+	{
+		//Jobs are handed out one at a time so uneven jobs (e.g. busy tiles) balance themselves
+		for (uint32_t jobIdx{ m_NextJob++ }; jobIdx < m_JobCount; jobIdx = m_NextJob++)
+		{
+			(*m_pJob)(jobIdx, threadIdx);
+		}
+	}
+}
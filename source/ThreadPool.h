@@ -0,0 +1,49 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		//The calling thread also executes jobs, so nrThreads - 1 workers are spawned
+		explicit ThreadPool(uint32_t nrThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+		//Calls job(jobIdx, threadIdx) for every jobIdx in [0, jobCount) and blocks until all of them are done
+		//threadIdx is in [0, GetThreadCount()) and can be used to index per-thread scratch memory
+		void ParallelFor(uint32_t jobCount, const std::function<void(uint32_t, uint32_t)>& job);
+
+	private:
+		std::vector<std::thread> m_Workers{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const std::function<void(uint32_t, uint32_t)>* m_pJob{ nullptr };
+		uint32_t m_JobCount{};
+		std::atomic<uint32_t> m_NextJob{};
+		uint32_t m_NrBusyWorkers{};
+		uint64_t m_Generation{};
+		bool m_IsShuttingDown{ false };
+
+		void WorkerLoop(uint32_t threadIdx);
+		void RunJobs(uint32_t threadIdx);
+	};
+}
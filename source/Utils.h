@@ -11,6 +11,7 @@ namespace dae
 	namespace Utils
 	{
 		//Just parses vertices and indices
+		//ObjParser::Parse gives the same output from a mapped file in parallel, this one stays as the reference
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
@@ -0,0 +1,208 @@
+#include "VertexStageAVX2.h"
+
+//Standard includes
+#include <immintrin.h>
+
+//Project includes
+#include "Clipping.h"
+
+namespace dae
+{
+	namespace VertexStageAVX2
+	{
+		//Rows of a matrix, each element broadcast
+		struct BroadcastMatrix
+		{
+			__m256 rows[4][4];
+
+			explicit BroadcastMatrix(const Matrix& matrix)
+			{
+				for (int row{}; row < 4; ++row)
+				{
+					const Vector4 values{ matrix[row] };
+					rows[row][0] = _mm256_set1_ps(values.x);
+					rows[row][1] = _mm256_set1_ps(values.y);
+					rows[row][2] = _mm256_set1_ps(values.z);
+					rows[row][3] = _mm256_set1_ps(values.w);
+				}
+			}
+		};
+
+		//Same order of operations as Matrix::TransformVector, component is x, y, z or w
+		static __m256 TransformVector(const BroadcastMatrix& matrix, int component, __m256 x, __m256 y, __m256 z)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(matrix.rows[0][component], x), _mm256_mul_ps(matrix.rows[1][component], y)), _mm256_mul_ps(matrix.rows[2][component], z));
+		}
+
+		//Same as Matrix::TransformPoint
+		static __m256 TransformPoint(const BroadcastMatrix& matrix, int component, __m256 x, __m256 y, __m256 z)
+		{
+			return _mm256_add_ps(TransformVector(matrix, component, x, y, z), matrix.rows[3][component]);
+		}
+
+		//Same as Vector3::Normalized
+		static void Normalize(__m256& x, __m256& y, __m256& z)
+		{
+			const __m256 magnitude{ _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z))) };
+			x = _mm256_div_ps(x, magnitude);
+			y = _mm256_div_ps(y, magnitude);
+			z = _mm256_div_ps(z, magnitude);
+		}
+
+		//Clip code bit for the lanes where isOutside is set
+		static __m256i GetClipBits(__m256 isOutside, Clipping::ClipCode code)
+		{
+			return _mm256_and_si256(_mm256_castps_si256(isOutside), _mm256_set1_epi32(code));
+		}
+
+		//Same as Clipping::GetClipCode
+		static __m256i GetClipCodes(__m256 x, __m256 y, __m256 z, __m256 w)
+		{
+			const __m256 signBit{ _mm256_set1_ps(-0.f) };
+			const __m256 negativeW{ _mm256_xor_ps(w, signBit) };
+			const __m256 guardBandW{ _mm256_mul_ps(_mm256_set1_ps(Clipping::GuardBand), w) };
+			const __m256 negativeGuardBandW{ _mm256_xor_ps(guardBandW, signBit) };
+
+			__m256i codes{ GetClipBits(_mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ), Clipping::Near) };
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(z, w, _CMP_GT_OQ), Clipping::Far));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(x, negativeW, _CMP_LT_OQ), Clipping::Left));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(x, w, _CMP_GT_OQ), Clipping::Right));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(y, negativeW, _CMP_LT_OQ), Clipping::Bottom));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(y, w, _CMP_GT_OQ), Clipping::Top));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(x, negativeGuardBandW, _CMP_LT_OQ), Clipping::GuardBandLeft));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(x, guardBandW, _CMP_GT_OQ), Clipping::GuardBandRight));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(y, negativeGuardBandW, _CMP_LT_OQ), Clipping::GuardBandBottom));
+			codes = _mm256_or_si256(codes, GetClipBits(_mm256_cmp_ps(y, guardBandW, _CMP_GT_OQ), Clipping::GuardBandTop));
+			return codes;
+		}
+
+		//Results of a group go through memory to get back to the Vertex_Out layout
+		enum Output
+		{
+			ScreenX, ScreenY, ScreenZ, ClipW,
+			NormalX, NormalY, NormalZ,
+			TangentX, TangentY, TangentZ,
+			ViewX, ViewY, ViewZ,
+			NrOutputs
+		};
+
+		//Clip code and screen position of 8 vertices, same as Renderer::TransformVertexPosition
+		//Fills in the ScreenX to ClipW outputs
+		static void ProjectGroup(const BroadcastMatrix& worldViewProjection, __m256 x, __m256 y, __m256 z, float width, float height,
+			float (&outputs)[NrOutputs][8], uint32_t (&clipCodes)[8])
+		{
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			//Halving is exact, so multiplying by 0.5 gives the same bits as the scalar division by 2
+			const __m256 half{ _mm256_set1_ps(0.5f) };
+
+			const __m256 clipX{ TransformPoint(worldViewProjection, 0, x, y, z) };
+			const __m256 clipY{ TransformPoint(worldViewProjection, 1, x, y, z) };
+			const __m256 clipZ{ TransformPoint(worldViewProjection, 2, x, y, z) };
+			const __m256 clipW{ TransformPoint(worldViewProjection, 3, x, y, z) };
+			_mm256_store_si256(reinterpret_cast<__m256i*>(clipCodes), GetClipCodes(clipX, clipY, clipZ, clipW));
+
+			//Perspective divide and viewport
+			const __m256 invW{ _mm256_div_ps(one, clipW) };
+			const __m256 ndcX{ _mm256_mul_ps(clipX, invW) };
+			const __m256 ndcY{ _mm256_mul_ps(clipY, invW) };
+			_mm256_store_ps(outputs[ScreenX], _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(ndcX, one), half), _mm256_set1_ps(width)));
+			_mm256_store_ps(outputs[ScreenY], _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, ndcY), half), _mm256_set1_ps(height)));
+			_mm256_store_ps(outputs[ScreenZ], _mm256_mul_ps(clipZ, invW));
+			_mm256_store_ps(outputs[ClipW], clipW);
+		}
+
+		size_t TransformVertices(const Mesh& mesh, const Vector3& cameraOrigin, float width, float height, size_t begin, size_t end,
+			Vertex_Out* pVerticesOut, uint16_t* pClipCodesOut)
+		{
+			const BroadcastMatrix world{ mesh.worldMatrix };
+			const BroadcastMatrix worldViewProjection{ mesh.worldViewProjection };
+			const __m256 origin[3]{ _mm256_set1_ps(cameraOrigin.x), _mm256_set1_ps(cameraOrigin.y), _mm256_set1_ps(cameraOrigin.z) };
+
+			const float* pStreams[static_cast<int>(VertexStream::Count)]{};
+			for (int stream{}; stream < static_cast<int>(VertexStream::Count); ++stream)
+			{
+				pStreams[stream] = mesh.GetVertexStream(static_cast<VertexStream>(stream));
+			}
+
+			alignas(32) float outputs[NrOutputs][8];
+			alignas(32) uint32_t clipCodes[8];
+
+			for (; begin + 8 <= end; begin += 8)
+			{
+				//Color and uv are only copied, they are read per lane below
+				__m256 input[static_cast<int>(VertexStream::TangentZ) + 1];
+				for (int stream{}; stream <= static_cast<int>(VertexStream::TangentZ); ++stream)
+				{
+					input[stream] = _mm256_loadu_ps(pStreams[stream] + begin);
+				}
+				const __m256& x{ input[static_cast<int>(VertexStream::PositionX)] };
+				const __m256& y{ input[static_cast<int>(VertexStream::PositionY)] };
+				const __m256& z{ input[static_cast<int>(VertexStream::PositionZ)] };
+
+				for (int attribute{}; attribute < 2; ++attribute)
+				{
+					const int firstStream{ static_cast<int>(attribute == 0 ? VertexStream::NormalX : VertexStream::TangentX) };
+					__m256 vector[3]{};
+					for (int component{}; component < 3; ++component)
+					{
+						vector[component] = TransformVector(world, component, input[firstStream], input[firstStream + 1], input[firstStream + 2]);
+					}
+					Normalize(vector[0], vector[1], vector[2]);
+
+					const int firstOutput{ attribute == 0 ? NormalX : TangentX };
+					for (int component{}; component < 3; ++component)
+					{
+						_mm256_store_ps(outputs[firstOutput + component], vector[component]);
+					}
+				}
+
+				for (int component{}; component < 3; ++component)
+				{
+					_mm256_store_ps(outputs[ViewX + component], _mm256_sub_ps(TransformPoint(world, component, x, y, z), origin[component]));
+				}
+
+				ProjectGroup(worldViewProjection, x, y, z, width, height, outputs, clipCodes);
+
+				for (int lane{}; lane < 8; ++lane)
+				{
+					const size_t idx{ begin + lane };
+					Vertex_Out& out{ pVerticesOut[idx] };
+					out.color = ColorRGB{ pStreams[static_cast<int>(VertexStream::ColorR)][idx], pStreams[static_cast<int>(VertexStream::ColorG)][idx], pStreams[static_cast<int>(VertexStream::ColorB)][idx] };
+					out.uv = Vector2{ pStreams[static_cast<int>(VertexStream::U)][idx], pStreams[static_cast<int>(VertexStream::V)][idx] };
+					out.position = Vector4{ outputs[ScreenX][lane], outputs[ScreenY][lane], outputs[ScreenZ][lane], outputs[ClipW][lane] };
+					out.normal = Vector3{ outputs[NormalX][lane], outputs[NormalY][lane], outputs[NormalZ][lane] };
+					out.tangent = Vector3{ outputs[TangentX][lane], outputs[TangentY][lane], outputs[TangentZ][lane] };
+					out.viewDirection = Vector3{ outputs[ViewX][lane], outputs[ViewY][lane], outputs[ViewZ][lane] };
+					pClipCodesOut[idx] = static_cast<uint16_t>(clipCodes[lane]);
+				}
+			}
+
+			return begin;
+		}
+
+		size_t TransformPositions(const Mesh& mesh, float width, float height, size_t begin, size_t end, Vertex_Out* pVerticesOut, uint16_t* pClipCodesOut)
+		{
+			const BroadcastMatrix worldViewProjection{ mesh.worldViewProjection };
+			const float* pX{ mesh.GetVertexStream(VertexStream::PositionX) };
+			const float* pY{ mesh.GetVertexStream(VertexStream::PositionY) };
+			const float* pZ{ mesh.GetVertexStream(VertexStream::PositionZ) };
+
+			alignas(32) float outputs[NrOutputs][8];
+			alignas(32) uint32_t clipCodes[8];
+
+			for (; begin + 8 <= end; begin += 8)
+			{
+				ProjectGroup(worldViewProjection, _mm256_loadu_ps(pX + begin), _mm256_loadu_ps(pY + begin), _mm256_loadu_ps(pZ + begin), width, height, outputs, clipCodes);
+
+				for (int lane{}; lane < 8; ++lane)
+				{
+					const size_t idx{ begin + lane };
+					pVerticesOut[idx].position = Vector4{ outputs[ScreenX][lane], outputs[ScreenY][lane], outputs[ScreenZ][lane], outputs[ClipW][lane] };
+					pClipCodesOut[idx] = static_cast<uint16_t>(clipCodes[lane]);
+				}
+			}
+
+			return begin;
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	//8 wide path of Renderer::VertexTransformationFunction, reads Mesh::vertexStreams
+	//Only call these when CpuFeatures::HasAVX2() and the mesh has vertex streams
+	namespace VertexStageAVX2
+	{
+		//Same outputs as the scalar loop, bit for bit, for the vertices in [begin, end) in groups of 8
+		//mesh.worldViewProjection has to be set already
+		//Returns the first vertex it didn't transform, the last (end - begin) % 8 are left to the scalar loop
+		size_t TransformVertices(const Mesh& mesh, const Vector3& cameraOrigin, float width, float height, size_t begin, size_t end,
+			Vertex_Out* pVerticesOut, uint16_t* pClipCodesOut);
+
+		//Only the position of vertices_out and the clip codes, the lazy vertices path transforms the attributes later
+		size_t TransformPositions(const Mesh& mesh, float width, float height, size_t begin, size_t end, Vertex_Out* pVerticesOut, uint16_t* pClipCodesOut);
+	}
+}
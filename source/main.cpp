@@ -6,10 +6,13 @@
 
 //Standard includes
 #include <iostream>
+#include <string>
 
 //Project includes
+#include "Benchmark.h"
 #include "Timer.h"
 #include "Renderer.h"
+#include "Texture.h"
 
 using namespace dae;
 
@@ -21,13 +24,45 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
-
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
+	//Run a benchmark instead of the demo, e.g. "Rasterizer.exe --benchmark traversal"
+	if (argc >= 3 && std::string{ args[1] } == "--benchmark")
+	{
+		const bool exists{ Benchmark::Run(args[2]) };
+		if (!exists)
+			std::cout << "Unknown benchmark: " << args[2] << std::endl;
+
+		SDL_Quit();
+		return exists ? 0 : 1;
+	}
+
+	//Compress an image offline, e.g. "Rasterizer.exe --compress Resources/vehicle_normal.png vehicle_normal.dds bc5"
+	//The .dds can be loaded with Texture::LoadFromFile like any other image
+	if (argc >= 5 && std::string{ args[1] } == "--compress")
+	{
+		const std::string formatName{ args[4] };
+		TextureFormat format{ TextureFormat::RGBA8 };
+		if (formatName == "bc1")
+			format = TextureFormat::BC1;
+		else if (formatName == "bc3")
+			format = TextureFormat::BC3;
+		else if (formatName == "bc5")
+			format = TextureFormat::BC5;
+
+		const Texture* pTexture{ format != TextureFormat::RGBA8 ? Texture::LoadFromFile(args[2], TextureLayout::Linear, format) : nullptr };
+		const bool isSaved{ pTexture && pTexture->SaveToDDS(args[3]) };
+		if (isSaved)
+			std::cout << "Compressed " << args[2] << " to " << args[3] << ", " << pTexture->GetMemorySize() << " bytes" << std::endl;
+		else
+			std::cout << "Couldn't compress " << args[2] << " to " << args[3] << " as " << formatName << " (bc1, bc3 or bc5)" << std::endl;
+
+		delete pTexture;
+		SDL_Quit();
+		return isSaved ? 0 : 1;
+	}
+
 	const uint32_t width = 640;
 	const uint32_t height = 480;
 
@@ -81,6 +116,26 @@ int main(int argc, char* args[])
 				{
 					pRenderer->ToggleNormalMap();
 				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					pRenderer->ToggleTextureFilter();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					pRenderer->ToggleTextureAddress();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					pRenderer->ToggleBlockCompression();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+				{
+					pRenderer->ToggleLazyVertices();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
+				{
+					pRenderer->ToggleMeshletCulling();
+				}
 				break;
 			}
 		}
@@ -99,6 +154,10 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+
+			const RenderStats& stats{ pRenderer->GetStats() };
+			std::cout << "Triangles: " << stats.nrTriangles << ", frustum culled: " << stats.nrFrustumCulled << ", clipped: " << stats.nrClipped << ", face culled: " << stats.nrFaceCulled
+				<< ", meshes culled: " << stats.nrMeshesCulled << ", meshlets culled: " << stats.nrMeshletsCulled << ", vertices transformed: " << stats.nrVerticesTransformed << " of " << stats.nrVertices << std::endl;
 		}
 
 		//Save screenshot after full render